@@ -0,0 +1,6 @@
+#! /bin/bash
+
+cmake -S . -B build
+cmake --build build/
+./build/bench-keyframe 100 10 2000
+./build/bench-keyframe 400 10 500
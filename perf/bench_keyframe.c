@@ -0,0 +1,126 @@
+/*
+ * bench_keyframe.c
+ *
+ * Keyframe microbenchmark, builds a page of
+ * rectangles with a keyframed position and
+ * colour, then times graphics_page_interpolate_geometry,
+ * graphics_page_calculate_keyframes and the keyframe
+ * graph node lookup.
+ *
+ *      ./build/bench-keyframe [num_geo] [num_keyframes] [iterations]
+ *
+ */
+
+#include "chroma-typedefs.h"
+#include "graphics.h"
+#include "graphics/graphics_internal.h"
+#include "geometry.h"
+#include "log.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_FRAME_WIDTH    120
+
+static void bench_keyframe(IPage *page, int frame_num, int geo_id,
+                           GeometryAttr attr, FrameType type, double value) {
+    Keyframe frame;
+    memset(&frame, 0, sizeof frame);
+
+    frame.frame_num = frame_num;
+    frame.geo_id = geo_id;
+    frame.attr = attr;
+    frame.type = type;
+    frame.value = value;
+
+    graphics_page_gen_frame(page, frame);
+}
+
+static IPage *bench_page(int num_geo, int num_keyframes) {
+    IPage *page = graphics_hub_new_page(&engine.hub, num_geo, num_keyframes, 0);
+
+    for (int geo_id = 1; geo_id < num_geo; geo_id++) {
+        IGeometry *geo = graphics_page_add_geometry(page, RECT, geo_id);
+
+        geometry_set_int_attr(geo, GEO_PARENT, 0);
+        geometry_set_int_attr(geo, GEO_REL_X, 20 * (geo_id % 90));
+        geometry_set_int_attr(geo, GEO_REL_Y, 10 * (geo_id / 90));
+        geometry_set_int_attr(geo, GEO_WIDTH, 100);
+        geometry_set_int_attr(geo, GEO_HEIGHT, 50);
+        geometry_set_float_attr(geo, GEO_COLOR_A, 1.0);
+    }
+
+    for (int geo_id = 1; geo_id < num_geo; geo_id++) {
+        bench_keyframe(page, 0, geo_id, GEO_REL_X, SET_FRAME, -400);
+        bench_keyframe(page, 1, geo_id, GEO_REL_X, USER_FRAME, 0);
+
+        for (int frame_num = 2; frame_num < num_keyframes; frame_num++) {
+            bench_keyframe(page, frame_num, geo_id, GEO_COLOR_A, SET_FRAME, 1.0 / frame_num);
+        }
+    }
+
+    graphics_page_default_relations(page);
+    graphics_page_calculate_keyframes(page);
+
+    return page;
+}
+
+static double bench_elapsed_ms(struct timespec *start, struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+int main(int argc, char **argv) {
+    int num_geo = (argc > 1) ? atoi(argv[1]) : 100;
+    int num_keyframes = (argc > 2) ? atoi(argv[2]) : 10;
+    int iterations = (argc > 3) ? atoi(argv[3]) : 2000;
+    int num_frames = (num_keyframes - 1) * BENCH_FRAME_WIDTH;
+    struct timespec start, end;
+
+    if (num_geo < 2 || num_keyframes < 2 || iterations < 1) {
+        printf("Usage: %s [num_geo] [num_keyframes] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    log_start("./log");
+    graphics_new_graphics_hub(&engine.hub, 1);
+
+    IPage *page = bench_page(num_geo, num_keyframes);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; i++) {
+        graphics_page_interpolate_geometry(page, i % num_frames, BENCH_FRAME_WIDTH);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    printf("interpolate: %d geometry, %d keyframes, %f ms/frame\n",
+           num_geo, num_keyframes, bench_elapsed_ms(&start, &end) / iterations);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; i++) {
+        graphics_page_calculate_keyframes(page);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    printf("calculate:   %f ms\n", bench_elapsed_ms(&start, &end) / iterations);
+
+    size_t num_lookups = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; i++) {
+        for (size_t index = 0; index < page->keyframe_graph.node_count; index++) {
+            for (GeometryAttr attr = 0; attr < GEO_NUMBER; attr++) {
+                num_lookups += (graphics_graph_get_node(&page->keyframe_graph, index, attr) != NULL);
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    printf("lookup:      %f ns/lookup (%lu found)\n", 
+           bench_elapsed_ms(&start, &end) * 1000000.0 / 
+           ((double) iterations * page->keyframe_graph.node_count * GEO_NUMBER), num_lookups);
+    printf("graph:       %lu nodes, %lu edges, %lu bytes\n",
+           page->keyframe_graph.num_nodes, page->keyframe_graph.num_edges,
+           graphics_graph_size(&page->keyframe_graph));
+
+    graphics_free_graphics_hub(&engine.hub);
+    return 0;
+}
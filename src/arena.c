@@ -0,0 +1,142 @@
+/*
+ * arena.c
+ *
+ * Chunked arena, see arena.h
+ */
+
+#include "arena.h"
+#include "chroma-macros.h"
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define ARENA_ALIGN_UP(x, align)  (((x) + (align) - 1) & ~((uint64_t) (align) - 1))
+#define ARENA_HEADER              ARENA_ALIGN_UP(sizeof( ArenaBlock ), ARENA_ALIGN)
+
+static int8_t *arena_block_memory(ArenaBlock *block) {
+    return (int8_t *) block + ARENA_HEADER;
+}
+
+/*
+ * Return the pages of the block after offset
+ * to the system, the block stays mapped.
+ */
+static void arena_block_release(ArenaBlock *block, uint64_t offset) {
+    uint64_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t start = ARENA_ALIGN_UP((uintptr_t) arena_block_memory(block) + offset, page_size);
+    uintptr_t end = (uintptr_t) arena_block_memory(block) + block->size;
+
+    if (start < end) {
+        madvise((void *) start, end - start, MADV_DONTNEED);
+    }
+}
+
+static ArenaBlock *arena_new_block(Arena *a, uint64_t size) {
+    ArenaBlock **prev = &a->spare;
+    ArenaBlock *block;
+
+    // reuse a released block if one is large enough
+    for (block = a->spare; block != NULL; block = block->prev) {
+        if (block->size >= size) {
+            *prev = block->prev;
+            break;
+        }
+
+        prev = &block->prev;
+    }
+
+    if (block == NULL) {
+        uint64_t page_size = sysconf(_SC_PAGESIZE);
+        uint64_t map_size = ARENA_ALIGN_UP(MAX(size, a->block_size) + ARENA_HEADER, page_size);
+
+        block = mmap(NULL, map_size, PROT_WRITE | PROT_READ, MAP_PRIVATE | MAP_ANON, -1, 0);
+        log_assert(block != MAP_FAILED, "System", "Unable to allocate arena block");
+
+        block->size = map_size - ARENA_HEADER;
+        a->reserved += map_size;
+        a->num_blocks++;
+    }
+
+    block->allocd = 0;
+    block->prev = a->block;
+    a->block = block;
+
+    return block;
+}
+
+void arena_init(Arena *a, uint64_t block_size) {
+    memset(a, 0, sizeof( Arena ));
+    a->block_size = block_size;
+}
+
+void *arena_alloc(Arena *a, uint64_t size) {
+    ArenaBlock *block = a->block;
+    size = ARENA_ALIGN_UP(size, ARENA_ALIGN);
+
+    if (block == NULL || block->allocd + size > block->size) {
+        block = arena_new_block(a, size);
+    }
+
+    void *ptr = arena_block_memory(block) + block->allocd;
+    block->allocd += size;
+
+    a->allocd += size;
+    a->peak = MAX(a->peak, a->allocd);
+
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+ArenaMark arena_mark(Arena *a) {
+    ArenaMark mark = {
+        .block = a->block,
+        .offset = (a->block == NULL) ? 0 : a->block->allocd,
+        .allocd = a->allocd,
+    };
+
+    return mark;
+}
+
+/*
+ * Release the allocations made after the mark, the
+ * released blocks are kept for later allocations.
+ */
+void arena_rewind(Arena *a, ArenaMark mark) {
+    while (a->block != mark.block) {
+        ArenaBlock *block = a->block;
+        log_assert(block != NULL, "System", "Arena mark is not in the arena");
+
+        a->block = block->prev;
+        arena_block_release(block, 0);
+
+        block->allocd = 0;
+        block->prev = a->spare;
+        a->spare = block;
+    }
+
+    if (a->block != NULL) {
+        a->block->allocd = mark.offset;
+        arena_block_release(a->block, mark.offset);
+    }
+
+    a->allocd = mark.allocd;
+}
+
+void arena_reset(Arena *a) {
+    ArenaMark mark = {NULL, 0, 0};
+    arena_rewind(a, mark);
+}
+
+static void arena_unmap(ArenaBlock *block) {
+    while (block != NULL) {
+        ArenaBlock *prev = block->prev;
+        munmap(block, block->size + ARENA_HEADER);
+        block = prev;
+    }
+}
+
+void arena_free(Arena *a) {
+    arena_unmap(a->block);
+    arena_unmap(a->spare);
+    arena_init(a, a->block_size);
+}
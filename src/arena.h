@@ -2,6 +2,30 @@
  * arena.h
  *
  * Arena implementation
+ *
+ * An arena is a list of blocks mapped with mmap,
+ * a new block of block_size bytes (or larger, for
+ * a large allocation) is mapped when the current
+ * block is full, so an arena only maps the memory
+ * it uses. Allocations are zeroed and aligned to
+ * ARENA_ALIGN bytes, and are never moved.
+ *
+ *      void arena_init(Arena *a, uint64_t block_size);
+ *      void *arena_alloc(Arena *a, uint64_t size);
+ *      ArenaMark arena_mark(Arena *a);
+ *      void arena_rewind(Arena *a, ArenaMark mark);
+ *      void arena_reset(Arena *a);
+ *      void arena_free(Arena *a);
+ *
+ * arena_rewind releases every allocation made since
+ * the mark, and arena_reset every allocation. The
+ * released memory is returned to the system with
+ * madvise(MADV_DONTNEED), and the released blocks
+ * are kept to be reused by later allocations.
+ *
+ * The arena keeps usage stats, allocd and peak are
+ * the bytes allocated now and at most, reserved is
+ * the bytes mapped in num_blocks blocks.
  */
 
 #ifndef ARENA_H
@@ -11,41 +35,46 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#define ARENA_ALIGN       16
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *prev;
+    uint64_t          size;
+    uint64_t          allocd;
+} ArenaBlock;
+
 typedef struct {
-    uint64_t size;
-    uint64_t allocd;
-    int8_t   *memory;
+    uint64_t   block_size;
+    ArenaBlock *block;
+    ArenaBlock *spare;
+
+    uint64_t   allocd;
+    uint64_t   peak;
+    uint64_t   reserved;
+    uint64_t   num_blocks;
 } Arena;
 
-#define ARENA_INIT(arena, capacity)                                                        \
-    do {                                                                                   \
-        (arena)->allocd = 0;                                                               \
-        (arena)->size = capacity;                                                          \
-        (arena)->memory = mmap(NULL, (arena)->size, PROT_WRITE | PROT_READ,                \
-                MAP_PRIVATE | MAP_ANON, 0, 0);                                             \
-        log_assert((arena)->memory != MAP_FAILED,                                          \
-                "System", "Unable to allocate arena: " __FILE__);                          \
-    } while (0)
-
-#define ARENA_ALLOC(arena, struct_type) ({                                                 \
-        uint64_t struct_size = sizeof( struct_type );                                      \
-        log_assert((arena)->allocd + struct_size < (arena)->size,                          \
-                "System", "Arena out of memory " __FILE__);                                \
-        struct_type *ptr = (struct_type *)((arena)->memory + (arena)->allocd);             \
-        (arena)->allocd += struct_size;                                                    \
-        memset(ptr, 0, struct_size);                                                       \
-        ptr;                                                                               \
-    })
-
-#define ARENA_ARRAY(arena, count, struct_type) ({                                          \
-        uint64_t struct_size = (uint64_t) count * sizeof( struct_type );                   \
-        log_assert((arena)->allocd + struct_size < (arena)->size,                          \
-                "System", "Arena out of memory " __FILE__);                                \
-        struct_type *ptr = (struct_type *)((arena)->memory + (arena)->allocd);             \
-        (arena)->allocd += struct_size;                                                    \
-        memset(ptr, 0, struct_size);                                                       \
-        ptr;                                                                               \
-    })
+typedef struct {
+    ArenaBlock *block;
+    uint64_t   offset;
+    uint64_t   allocd;
+} ArenaMark;
 
-#endif // !ARENA_H
+/* arena.c */
+void      arena_init(Arena *a, uint64_t block_size);
+void      *arena_alloc(Arena *a, uint64_t size);
+ArenaMark arena_mark(Arena *a);
+void      arena_rewind(Arena *a, ArenaMark mark);
+void      arena_reset(Arena *a);
+void      arena_free(Arena *a);
+
+#define ARENA_INIT(arena, block_size)                                                      \
+    arena_init((arena), (block_size))
 
+#define ARENA_ALLOC(arena, struct_type)                                                    \
+    ((struct_type *) arena_alloc((arena), sizeof( struct_type )))
+
+#define ARENA_ARRAY(arena, count, struct_type)                                             \
+    ((struct_type *) arena_alloc((arena), (uint64_t) (count) * sizeof( struct_type )))
+
+#endif // !ARENA_H
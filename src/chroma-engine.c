@@ -39,17 +39,29 @@ int main(int argc, char **argv) {
     int x;
     int hflag = 0;
     int cflag = 0;
+    int nflag = 0;
 
     char *config_path = "";
+    char *dump_path = "";
+    int num_frames = 0;
     opterr = 0;
 
-    while ((x = getopt(argc, argv, "c:hw:")) != -1) {
+    while ((x = getopt(argc, argv, "c:hw:n:o:")) != -1) {
         switch (x) {
             case 'c':
                 cflag = 1;
                 config_path = optarg;
                 break;
 
+            case 'n':
+                nflag = 1;
+                num_frames = atoi(optarg);
+                break;
+
+            case 'o':
+                dump_path = optarg;
+                break;
+
             case 'h':
                 hflag = 1;
                 break;
@@ -63,6 +75,8 @@ int main(int argc, char **argv) {
     if (hflag) {
         printf("Usage:\n");
         printf("  -c [file]\tConfig File\n");
+        printf("  -n [frames]\tRender frames headless\n");
+        printf("  -o [dir]\tDump headless frames to dir\n");
         return 0;
     }
 
@@ -71,6 +85,10 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    if (nflag) {
+        return chroma_run_headless(num_frames, dump_path) < 0;
+    }
+
     GtkApplication *app;
     int status;
 
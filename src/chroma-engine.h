@@ -11,5 +11,6 @@
 
 int        chroma_init_renderer(char *config_path, char *log_path);
 GtkWidget  *chroma_new_renderer(void);
+int        chroma_run_headless(int num_frames, char *dump_path);
 
 #endif // !CHROMA_ENGINE
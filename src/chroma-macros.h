@@ -75,6 +75,7 @@
 #define WITHIN(a, x, y)               ((x <= a) && (a <= y))
 #define MIN(a, b)                     (((a) < (b)) ? (a) : (b))
 #define MAX(a, b)                     (((a) > (b)) ? (a) : (b))
+#define CLAMP(a, x, y)                MIN(MAX(a, x), y)
 #define INDEX(x, y, z, y_len, z_len)  x * (y_len * z_len) + y * z_len + z
 
 #define MAX_BUF_SIZE                  512
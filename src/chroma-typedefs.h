@@ -27,15 +27,34 @@ typedef struct {
 
 /* graphics structs */
 typedef struct {
-    int client_sock;
-    char buf[PARSE_BUF_SIZE];
-    int buf_ptr;
+    int          client_sock;
+    PageStatus   status;
+
+    // ring buffer of received bytes, buf_len bytes
+    // from buf_head, scanned bytes have been 
+    // searched for the end of a message
+    char         *buf;
+    size_t       buf_capacity;
+    size_t       buf_head;
+    size_t       buf_len;
+    size_t       scanned;
+
+    // message being parsed, msg_ptr is the parse
+    // position in the message
+    char         *msg;
+    size_t       msg_len;
+    size_t       msg_ptr;
+    char         *msg_copy;
+    size_t       msg_copy_capacity;
 } Client;
 
 typedef struct {
     GMutex           lock;
     int              server_port;
     unsigned char    render_perf;
+
+    // held for each request and response on hub_socket
+    GMutex           hub_lock;
     int              hub_socket;
     char             hub_addr[MAX_BUF_SIZE];
     IGraphics        hub;
@@ -36,6 +36,7 @@
 
 #define GEO_BUF_SIZE          100
 #define MAX_NODES             100
+#define MAX_GRAPH_NODES       4096
 
 typedef enum {
     RECT,
@@ -90,8 +91,25 @@ typedef struct {
     int               mask_geo;
     vec2              bound_lower;
     vec2              bound_upper;
+
+    /* incremented when an attribute is set */
+    unsigned int      version;
 } IGeometry;
 
+/*
+ * Storage type of a numeric geometry attr, 
+ * see geometry_attr_field.
+ */
+typedef enum {
+    GEO_FIELD_NONE,
+    GEO_FIELD_FLOAT,
+    GEO_FIELD_INT,
+    GEO_FIELD_ANGLE,        // degrees, truncated and stored in radians
+    GEO_FIELD_INT_FLOAT,    // truncated and stored as a float
+
+    GEO_FIELD_NUMBER,
+} GeometryField;
+
 typedef struct {
     IGeometry         geo;
     int               width;
@@ -125,7 +143,12 @@ typedef struct {
     int               node_count;
     int               num_nodes;
     vec4              color;
-    vec2              nodes[MAX_NODES];
+
+    // changes when the nodes or graph type change, unique
+    // across graphs, so the renderer can keep the lines
+    // generated from the nodes
+    unsigned int      data_id;
+    vec2              nodes[MAX_GRAPH_NODES];
 } GeometryGraph;
 
 typedef struct {
@@ -141,6 +164,7 @@ typedef struct {
     int               w;
     int               h;
     int               image_id;
+    int               version;
     unsigned char     *data;
 } GeometryImage;
 
@@ -154,12 +178,17 @@ typedef struct {
 extern GeometryType geometry_geo_type(char *name);
 extern IGeometry    *geometry_create_geometry(Arena *a, GeometryType type);
 extern void         geometry_clean_geo(IGeometry *geo);
+extern size_t       geometry_geo_size(IGeometry *geo);
 
 extern GeometryAttr geometry_char_to_attr(char *attr);
+extern GeometryAttr geometry_name_to_attr(const char *name, size_t len);
 extern const char   *geometry_attr_to_char(GeometryAttr attr);
 extern void         geometry_set_attr(IGeometry *geo, char *attr, char *value);
+extern void         geometry_set_str_attr(IGeometry *geo, GeometryAttr attr, char *value);
 extern void         geometry_set_int_attr(IGeometry *geo, GeometryAttr attr, int value);
 extern void         geometry_set_float_attr(IGeometry *geo, GeometryAttr attr, float value);
+extern void         geometry_set_point_attr(IGeometry *geo, vec2 point, int index);
+extern GeometryField geometry_attr_field(IGeometry *geo, GeometryAttr attr, void **field);
 
 extern void         geometry_get_attr(IGeometry *geo, char *attr, char *value);
 extern int          geometry_get_int_attr(IGeometry *geo, GeometryAttr attr);
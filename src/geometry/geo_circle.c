@@ -100,3 +100,38 @@ void geometry_circle_set_attr(GeometryCircle *circle, GeometryAttr attr, char *v
 
 }
 
+GeometryField geometry_circle_attr_field(GeometryCircle *circle, GeometryAttr attr, void **field) {
+    switch (attr) {
+        case GEO_COLOR_R:
+            *field = &circle->color.x;
+            return GEO_FIELD_FLOAT;
+        case GEO_COLOR_G:
+            *field = &circle->color.y;
+            return GEO_FIELD_FLOAT;
+        case GEO_COLOR_B:
+            *field = &circle->color.z;
+            return GEO_FIELD_FLOAT;
+        case GEO_COLOR_A:
+            *field = &circle->color.w;
+            return GEO_FIELD_FLOAT;
+        case GEO_INNER_RADIUS:
+            *field = &circle->inner_radius;
+            return GEO_FIELD_INT;
+        case GEO_OUTER_RADIUS:
+            *field = &circle->outer_radius;
+            return GEO_FIELD_INT;
+        case GEO_START_ANGLE:
+            *field = &circle->start_angle;
+            return GEO_FIELD_ANGLE;
+        case GEO_END_ANGLE:
+            *field = &circle->end_angle;
+            return GEO_FIELD_ANGLE;
+        case GEO_WIDTH:
+        case GEO_HEIGHT:
+            return GEO_FIELD_NONE;
+        default:
+            log_file(LogWarn, "Geometry", "Geo attr not an circle attr: %s", geometry_attr_to_char(attr));
+            return GEO_FIELD_NONE;
+    }
+}
+
@@ -9,6 +9,12 @@
 #include "geometry_internal.h"
 #include <stdio.h>
 
+static gint next_data_id = 0;
+
+static void geometry_graph_changed(GeometryGraph *g) {
+    g->data_id = g_atomic_int_add(&next_data_id, 1) + 1;
+}
+
 GeometryGraph *geometry_new_graph(Arena *a) {
     GeometryGraph *g = ARENA_ALLOC(a, GeometryGraph);
     g->geo.geo_type = GRAPH;
@@ -25,6 +31,7 @@ void geometry_clean_graph(GeometryGraph *g) {
     memset(g->nodes, 0, sizeof g->nodes);
     memset(g->x_label, '\0', GEO_BUF_SIZE);
     memset(g->y_label, '\0', GEO_BUF_SIZE);
+    geometry_graph_changed(g);
 }
 
 void geometry_graph_get_attr(GeometryGraph *g, GeometryAttr attr, char *value) {
@@ -70,16 +77,28 @@ void geometry_graph_set_attr(GeometryGraph *graph, GeometryAttr attr, char *valu
             graph->color.w = (float) g_value;
             break;
         case GEO_POINT:
+            if (graph->node_count >= MAX_GRAPH_NODES) {
+                log_file(LogWarn, "Geometry", "Graph: Tried to specify too many nodes, expected at most %d", MAX_GRAPH_NODES);
+                break;
+            }
+
             sscanf(value, "%d %d", &x, &y);
             graph->nodes[graph->node_count].x = x;
             graph->nodes[graph->node_count].y = y;
             graph->node_count++;
+            geometry_graph_changed(graph);
 
             break;
         case GEO_NUM_POINTS:
-            graph->num_nodes = g_value;
+            if (g_value > MAX_GRAPH_NODES) {
+                log_file(LogWarn, "Geometry", "Graph: Tried to specify too many nodes %d, expected at most %d", g_value, MAX_GRAPH_NODES);
+                g_value = MAX_GRAPH_NODES;
+            }
+
+            graph->num_nodes = MAX(g_value, 0);
             graph->node_count = 0;
-            memset(graph->nodes, 0, sizeof graph->nodes);
+            memset(graph->nodes, 0, graph->num_nodes * sizeof( vec2 ));
+            geometry_graph_changed(graph);
             break;
         case GEO_GRAPH_TYPE:
             if (strncmp(value, "line", 4) == 0) {
@@ -95,8 +114,45 @@ void geometry_graph_set_attr(GeometryGraph *graph, GeometryAttr attr, char *valu
             } else {
                 log_file(LogWarn, "Geometry", "Unknown graph type (%s)", value);
             }
+
+            geometry_graph_changed(graph);
             break;
         default:
             log_file(LogWarn, "Geometry", "Geo attr not a graph attr: %s", geometry_attr_to_char(attr));
     }
 }
+
+/*
+ * Set the node at index, the nodes sent before 
+ * index are kept, as for the GEO_POINT attr.
+ */
+void geometry_graph_set_point(GeometryGraph *graph, vec2 vec, int index) {
+    if (index < 0 || index >= MAX_GRAPH_NODES) {
+        log_file(LogWarn, "Geometry", "Graph: Index %d out of range, expected at most %d nodes", index, MAX_GRAPH_NODES);
+        return;
+    }
+
+    graph->nodes[index] = vec;
+    graph->node_count = MAX(graph->node_count, index + 1);
+    geometry_graph_changed(graph);
+}
+
+GeometryField geometry_graph_attr_field(GeometryGraph *graph, GeometryAttr attr, void **field) {
+    switch (attr) {
+        case GEO_COLOR_R:
+            *field = &graph->color.x;
+            return GEO_FIELD_INT_FLOAT;
+        case GEO_COLOR_G:
+            *field = &graph->color.y;
+            return GEO_FIELD_INT_FLOAT;
+        case GEO_COLOR_B:
+            *field = &graph->color.z;
+            return GEO_FIELD_INT_FLOAT;
+        case GEO_COLOR_A:
+            *field = &graph->color.w;
+            return GEO_FIELD_INT_FLOAT;
+        default:
+            log_file(LogWarn, "Geometry", "Geo attr not a graph attr: %s", geometry_attr_to_char(attr));
+            return GEO_FIELD_NONE;
+    }
+}
@@ -21,6 +21,7 @@ void geometry_clean_image(GeometryImage *image) {
     image->image_id = -1;
     image->w = 0;
     image->h = 0;
+    image->version = 0;
     image->data = NULL;
 }
 
@@ -64,3 +65,23 @@ void geometry_image_set_attr(GeometryImage *image, GeometryAttr attr, char *valu
     }
 }
 
+GeometryField geometry_image_attr_field(GeometryImage *image, GeometryAttr attr, void **field) {
+    switch (attr) {
+        case GEO_SCALE:
+            *field = &image->scale;
+            return GEO_FIELD_FLOAT;
+        case GEO_WIDTH:
+            *field = &image->w;
+            return GEO_FIELD_INT;
+        case GEO_HEIGHT:
+            *field = &image->h;
+            return GEO_FIELD_INT;
+        case GEO_IMAGE_ID:
+            *field = &image->image_id;
+            return GEO_FIELD_INT;
+        default:
+            log_file(LogWarn, "Geometry", "Geo attr not an image attr: %s", geometry_attr_to_char(attr));
+            return GEO_FIELD_NONE;
+    }
+}
+
@@ -93,6 +93,26 @@ void geometry_polygon_set_attr(GeometryPolygon *poly, GeometryAttr attr, char *v
     }
 }
 
+GeometryField geometry_polygon_attr_field(GeometryPolygon *poly, GeometryAttr attr, void **field) {
+    switch (attr) {
+        case GEO_COLOR_R:
+            *field = &poly->color.x;
+            return GEO_FIELD_FLOAT;
+        case GEO_COLOR_G:
+            *field = &poly->color.y;
+            return GEO_FIELD_FLOAT;
+        case GEO_COLOR_B:
+            *field = &poly->color.z;
+            return GEO_FIELD_FLOAT;
+        case GEO_COLOR_A:
+            *field = &poly->color.w;
+            return GEO_FIELD_FLOAT;
+        default:
+            log_file(LogWarn, "Geometry", "Geo attr is not a poly attr: %s", geometry_attr_to_char(attr));
+            return GEO_FIELD_NONE;
+    }
+}
+
 void geometry_polygon_set_point(GeometryPolygon *poly, vec2 vec, int index) {
     if (index < 0 || index >= poly->num_vertices) {
         log_file(LogWarn, "Geometry", "Polygon: Index %d out of range to set (%d, %d)", index, vec.x, vec.y);
@@ -82,3 +82,32 @@ void geometry_rectangle_set_attr(GeometryRect *rect, GeometryAttr attr, char *va
     }
 }
 
+GeometryField geometry_rectangle_attr_field(GeometryRect *rect, GeometryAttr attr, void **field) {
+    switch (attr) {
+        case GEO_COLOR_R:
+            *field = &rect->color.x;
+            return GEO_FIELD_FLOAT;
+        case GEO_COLOR_G:
+            *field = &rect->color.y;
+            return GEO_FIELD_FLOAT;
+        case GEO_COLOR_B:
+            *field = &rect->color.z;
+            return GEO_FIELD_FLOAT;
+        case GEO_COLOR_A:
+            *field = &rect->color.w;
+            return GEO_FIELD_FLOAT;
+        case GEO_WIDTH:
+            *field = &rect->width;
+            return GEO_FIELD_INT;
+        case GEO_HEIGHT:
+            *field = &rect->height;
+            return GEO_FIELD_INT;
+        case GEO_ROUNDING:
+            *field = &rect->rounding;
+            return GEO_FIELD_INT;
+        default:
+            log_file(LogWarn, "Geometry", "Geo attr not a rect attr: %s", geometry_attr_to_char(attr));
+            return GEO_FIELD_NONE;
+    }
+}
+
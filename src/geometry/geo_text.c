@@ -84,3 +84,30 @@ void geometry_text_set_attr(GeometryText *text, GeometryAttr attr, char *value)
     }
 }
 
+GeometryField geometry_text_attr_field(GeometryText *text, GeometryAttr attr, void **field) {
+    switch (attr) {
+        case GEO_COLOR_R:
+            *field = &text->color.x;
+            return GEO_FIELD_FLOAT;
+        case GEO_COLOR_G:
+            *field = &text->color.y;
+            return GEO_FIELD_FLOAT;
+        case GEO_COLOR_B:
+            *field = &text->color.z;
+            return GEO_FIELD_FLOAT;
+        case GEO_COLOR_A:
+            *field = &text->color.w;
+            return GEO_FIELD_FLOAT;
+        case GEO_SCALE:
+            *field = &text->scale;
+            return GEO_FIELD_FLOAT;
+        case GEO_TEXT:
+        case GEO_WIDTH:
+        case GEO_HEIGHT:
+            return GEO_FIELD_NONE;
+        default:
+            log_file(LogWarn, "Geometry", "Geo attr not a text attr: %s", geometry_attr_to_char(attr));
+            return GEO_FIELD_NONE;
+    }
+}
+
@@ -89,6 +89,37 @@ IGeometry *geometry_create_geometry(Arena *a, GeometryType type) {
     return geo;
 }
 
+/*
+ * Size of the struct geo is stored in, 
+ * used to copy geometry.
+ */
+size_t geometry_geo_size(IGeometry *geo) {
+    switch (geo->geo_type) {
+        case RECT:
+            return sizeof( GeometryRect );
+
+        case CIRCLE:
+            return sizeof( GeometryCircle );
+
+        case TEXT:
+            return sizeof( GeometryText );
+
+        case GRAPH:
+            return sizeof( GeometryGraph );
+
+        case IMAGE:
+            return sizeof( GeometryImage );
+
+        case POLYGON:
+            return sizeof( GeometryPolygon );
+
+        default:
+            log_file(LogWarn, "Geometry", "Unknown geometry type (%d)", geo->geo_type);
+    }
+
+    return sizeof( IGeometry );
+}
+
 void geometry_clean_geo(IGeometry *geo) {
     geo->geo_id = 0;
     geo->parent_id = 0;
@@ -103,6 +134,7 @@ void geometry_clean_geo(IGeometry *geo) {
     geo->bound_lower.y = 0;
     geo->bound_upper.x = 0;
     geo->bound_upper.y = 0;
+    geo->version++;
 
     switch (geo->geo_type) {
         case RECT:
@@ -199,6 +231,71 @@ GeometryAttr geometry_char_to_attr(char *attr) {
     return g_attr;
 }
 
+/*
+ * Perfect hash of the attr names sent by Chroma Viz,
+ * each name has a different slot, so a name is found
+ * with one compare.
+ */
+#define ATTR_HASH_SIZE    64
+#define ATTR_HASH(name, len)                                                    \
+    ((3 * (unsigned char) (name)[0] +                                           \
+      4 * ((unsigned char) (name)[(len) / 2] + (unsigned char) (name)[(len) - 1])) \
+     & (ATTR_HASH_SIZE - 1))
+
+typedef struct {
+    const char   *name;
+    size_t       len;
+    GeometryAttr attr;
+} AttrName;
+
+static const AttrName attr_names[ATTR_HASH_SIZE] = {
+    [0]  = {"pos_y",        5,  GEO_POS_Y},
+    [1]  = {"green",        5,  GEO_COLOR_G},
+    [2]  = {"rounding",     8,  GEO_ROUNDING},
+    [4]  = {"point",        5,  GEO_POINT},
+    [5]  = {"graph_type",   10, GEO_GRAPH_TYPE},
+    [7]  = {"end_angle",    9,  GEO_END_ANGLE},
+    [14] = {"blue",         4,  GEO_COLOR_B},
+    [15] = {"inner_radius", 12, GEO_INNER_RADIUS},
+    [18] = {"num_points",   10, GEO_NUM_POINTS},
+    [21] = {"width",        5,  GEO_WIDTH},
+    [25] = {"string",       6,  GEO_TEXT},
+    [31] = {"image_id",     8,  GEO_IMAGE_ID},
+    [33] = {"outer_radius", 12, GEO_OUTER_RADIUS},
+    [36] = {"height",       6,  GEO_HEIGHT},
+    [38] = {"rel_x",        5,  GEO_REL_X},
+    [39] = {"alpha",        5,  GEO_COLOR_A},
+    [41] = {"start_angle",  11, GEO_START_ANGLE},
+    [42] = {"rel_y",        5,  GEO_REL_Y},
+    [44] = {"x_lower",      7,  GEO_X_LOWER},
+    [47] = {"y_lower",      7,  GEO_Y_LOWER},
+    [48] = {"x_upper",      7,  GEO_X_UPPER},
+    [49] = {"scale",        5,  GEO_SCALE},
+    [51] = {"y_upper",      7,  GEO_Y_UPPER},
+    [52] = {"parent",       6,  GEO_PARENT},
+    [58] = {"red",          3,  GEO_COLOR_R},
+    [60] = {"pos_x",        5,  GEO_POS_X},
+    [63] = {"mask",         4,  GEO_MASK},
+};
+
+/*
+ * Attr of the name of length len, which doesn't 
+ * need to be NUL terminated. Unlike 
+ * geometry_char_to_attr the name must match exactly.
+ */
+GeometryAttr geometry_name_to_attr(const char *name, size_t len) {
+    if (len > 0) {
+        const AttrName *entry = &attr_names[ATTR_HASH(name, len)];
+
+        if (entry->len == len && memcmp(entry->name, name, len) == 0) {
+            return entry->attr;
+        }
+    }
+
+    log_file(LogWarn, "Geometry", "Unknown geometry attr (%.*s)", (int) len, name);
+    return -1;
+}
+
 const char *geometry_attr_to_char(GeometryAttr attr) {
     switch (attr) {
     case GEO_POS_X:
@@ -427,6 +524,8 @@ void geometry_get_attr(IGeometry *geo, char *attr, char *value) {
 }
 
 static void geometry_set_attribute(IGeometry *geo, GeometryAttr attr, char *value) {
+    geo->version++;
+
     switch (attr) {
         case GEO_POS_X:
             sscanf(value, "%f", &geo->pos.x);
@@ -512,6 +611,14 @@ void geometry_set_attr(IGeometry *geo, char *attr, char *value) {
     geometry_set_attribute(geo, g_attr, value);
 }
 
+void geometry_set_str_attr(IGeometry *geo, GeometryAttr attr, char *value) {
+    if (geo == NULL) {
+        log_file(LogError, "Geometry", "Geometry is NULL");
+    }
+
+    geometry_set_attribute(geo, attr, value);
+}
+
 void geometry_set_int_attr(IGeometry *geo, GeometryAttr attr, int value) {
     char buf[GEO_BUF_SIZE];
     memset(buf, '\0', GEO_BUF_SIZE);
@@ -526,6 +633,114 @@ void geometry_set_float_attr(IGeometry *geo, GeometryAttr attr, float value) {
     geometry_set_attribute(geo, attr, buf);
 }
 
+/*
+ * Set the point at index of a graph or polygon, 
+ * the numeric form of the GEO_POINT attr.
+ */
+void geometry_set_point_attr(IGeometry *geo, vec2 point, int index) {
+    if (geo == NULL) {
+        log_file(LogError, "Geometry", "Geometry is NULL");
+        return;
+    }
+
+    geo->version++;
+
+    switch (geo->geo_type) {
+        case GRAPH:
+            geometry_graph_set_point((GeometryGraph *)geo, point, index);
+            break;
+
+        case POLYGON:
+            geometry_polygon_set_point((GeometryPolygon *)geo, point, index);
+            break;
+
+        default:
+            log_file(LogWarn, "Geometry", "Geo type %d doesn't have points", geo->geo_type);
+    }
+}
+
+/*
+ * Find the field attr is stored in, so the attr can 
+ * be written without the string round trip of
+ * geometry_set_float_attr. Returns GEO_FIELD_NONE if
+ * attr is not stored in a numeric field.
+ */
+GeometryField geometry_attr_field(IGeometry *geo, GeometryAttr attr, void **field) {
+    if (geo == NULL) {
+        log_file(LogError, "Geometry", "Geometry is NULL");
+    }
+
+    switch (attr) {
+        case GEO_POS_X:
+            *field = &geo->pos.x;
+            return GEO_FIELD_FLOAT;
+
+        case GEO_POS_Y:
+            *field = &geo->pos.y;
+            return GEO_FIELD_FLOAT;
+
+        case GEO_REL_X:
+            *field = &geo->rel.x;
+            return GEO_FIELD_FLOAT;
+
+        case GEO_REL_Y:
+            *field = &geo->rel.y;
+            return GEO_FIELD_FLOAT;
+
+        case GEO_PARENT:
+            *field = &geo->parent_id;
+            return GEO_FIELD_INT;
+
+        case GEO_MASK:
+            *field = &geo->mask_geo;
+            return GEO_FIELD_INT;
+
+        case GEO_X_LOWER:
+            *field = &geo->bound_lower.x;
+            return GEO_FIELD_FLOAT;
+
+        case GEO_X_UPPER:
+            *field = &geo->bound_upper.x;
+            return GEO_FIELD_FLOAT;
+
+        case GEO_Y_LOWER:
+            *field = &geo->bound_lower.y;
+            return GEO_FIELD_FLOAT;
+
+        case GEO_Y_UPPER:
+            *field = &geo->bound_upper.y;
+            return GEO_FIELD_FLOAT;
+
+        default:
+            break;
+    }
+
+    switch (geo->geo_type) {
+        case RECT:
+            return geometry_rectangle_attr_field((GeometryRect *)geo, attr, field);
+
+        case CIRCLE:
+            return geometry_circle_attr_field((GeometryCircle *)geo, attr, field);
+
+        case GRAPH:
+            return geometry_graph_attr_field((GeometryGraph *)geo, attr, field);
+
+        case TEXT:
+            return geometry_text_attr_field((GeometryText *)geo, attr, field);
+
+        case IMAGE:
+            return geometry_image_attr_field((GeometryImage *)geo, attr, field);
+        
+        case POLYGON:
+            return geometry_polygon_attr_field((GeometryPolygon *)geo, attr, field);
+
+        default:
+            log_file(LogWarn, "Geometry", "Unknown geo type %d", geo->geo_type);
+    }
+
+    return GEO_FIELD_NONE;
+}
+
 void geometry_graph_add_values(IGeometry *geo, void (*add_value)(GeometryAttr)) {
     add_value(GEO_REL_X);
     add_value(GEO_REL_Y);
@@ -22,30 +22,36 @@ GeometryRect *geometry_new_rectangle(Arena *a);
 void geometry_clean_rect(GeometryRect *rect);
 void geometry_rectangle_set_attr(GeometryRect *rect, GeometryAttr attr, char *value);
 void geometry_rectangle_get_attr(GeometryRect *rect, GeometryAttr attr, char *value);
+GeometryField geometry_rectangle_attr_field(GeometryRect *rect, GeometryAttr attr, void **field);
 
 /* geo_circle.c */
 GeometryCircle *geometry_new_circle(Arena *a);
 void geometry_clean_circle(GeometryCircle *circle);
 void geometry_circle_set_attr(GeometryCircle *circle, GeometryAttr attr, char *value);
 void geometry_circle_get_attr(GeometryCircle *circle, GeometryAttr attr, char *value);
+GeometryField geometry_circle_attr_field(GeometryCircle *circle, GeometryAttr attr, void **field);
 
 /* geo_graph.c */
 GeometryGraph *geometry_new_graph(Arena *a);
 void geometry_clean_graph(GeometryGraph *g);
 void geometry_graph_set_attr(GeometryGraph *g, GeometryAttr attr, char *value);
+void geometry_graph_set_point(GeometryGraph *g, vec2 vec, int index);
 void geometry_graph_get_attr(GeometryGraph *g, GeometryAttr attr, char *value);
+GeometryField geometry_graph_attr_field(GeometryGraph *g, GeometryAttr attr, void **field);
 
 /* geo_text.c */
 GeometryText *geometry_new_text(Arena *a);
 void geometry_clean_text(GeometryText *text);
 void geometry_text_set_attr(GeometryText *text, GeometryAttr attr, char *value);
 void geometry_text_get_attr(GeometryText *text, GeometryAttr attr, char *value);
+GeometryField geometry_text_attr_field(GeometryText *text, GeometryAttr attr, void **field);
 
 /* geo_image.c */
 GeometryImage *geometry_new_image(Arena *a);
 void geometry_clean_image(GeometryImage *image);
 void geometry_image_set_attr(GeometryImage *image, GeometryAttr attr, char *value);
 void geometry_image_get_attr(GeometryImage *image, GeometryAttr attr, char *value);
+GeometryField geometry_image_attr_field(GeometryImage *image, GeometryAttr attr, void **field);
 
 /* geo_poly.c */
 GeometryPolygon *geometry_new_polygon(Arena *a);
@@ -53,6 +59,7 @@ void geometry_clean_polygon(GeometryPolygon *poly);
 void geometry_polygon_set_attr(GeometryPolygon *poly, GeometryAttr attr, char *value);
 void geometry_polygon_set_point(GeometryPolygon *poly, vec2 vec, int index);
 void geometry_polygon_get_attr(GeometryPolygon *poly, GeometryAttr attr, char *value);
+GeometryField geometry_polygon_attr_field(GeometryPolygon *poly, GeometryAttr attr, void **field);
 vec2 geometry_polygon_get_point(GeometryPolygon *poly, int index);
 
 #endif // !GEOMETRY_INTERNAL
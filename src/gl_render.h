@@ -15,7 +15,14 @@
  * Once it has an action and page number, it updates the
  * animation frame of the page, and then calls the 
  * relevant gl render functions for each IGeometry in 
- * the page.
+ * the page. Frames are only rendered when
+ * gl_render_needs_frame() reports a layer has changed
+ * or is animating, otherwise the previous frame is kept.
+ *
+ * For running without a display, gl_headless_init()
+ * creates a surfaceless EGL context rendering to an
+ * offscreen framebuffer, and gl_headless_render()
+ * drives gl_render_frame() from a fixed clock.
  */
 
 #ifndef CHROMA_GL_RENDERER
@@ -32,6 +39,14 @@
 extern void gl_realize(GtkWidget *);
 extern gboolean gl_render(GtkGLArea *, GdkGLContext *);
 
+extern void gl_render_init(void);
+extern void gl_render_frame(void);
+extern int  gl_render_needs_frame(void);
+
+extern int  gl_headless_init(int width, int height);
+extern void gl_headless_render(int num_frames, char *dump_path);
+extern void gl_headless_free(void);
+
 extern unsigned int gl_text_text_width(char *text, float scale);
 extern unsigned int gl_text_text_height(char *text, float scale);
 
@@ -0,0 +1,106 @@
+/*
+ * gl_cache.c
+ *
+ * Cache of the quads generated for the geometry
+ * of a page snapshot, so geometry which has not 
+ * changed since the last frame is copied into 
+ * the renderer instead of generated again.
+ *
+ *      void gl_cache_page(PageCache *cache, unsigned int serial, size_t len_geometry);
+ *      unsigned char gl_cache_draw(Renderer *r, PageCache *cache, IGeometry *geo);
+ *      void gl_cache_store(Renderer *r, PageCache *cache, IGeometry *geo, size_t start);
+ *
+ * A cache holds the quads of one snapshot, identified
+ * by the snapshot serial, and is cleared when a new
+ * snapshot is drawn. Entries are keyed by the geometry
+ * version, which is incremented whenever an attribute 
+ * of the geometry is set or interpolated to a new value.
+ *
+ * The cache also holds the draw ops compiled from the 
+ * hierarchy of the snapshot, see gl_render.c.
+ *
+ */
+
+#include "gl_render_internal.h"
+
+/*
+ * Use the cache for the snapshot with the given 
+ * serial, clearing the cache if the snapshot changed.
+ */
+void gl_cache_page(PageCache *cache, unsigned int serial, size_t len_geometry) {
+    if (cache->valid && cache->serial == serial) {
+        return;
+    }
+
+    if (cache->len_geometry < len_geometry) {
+        GeometryCache *geometry = NEW_ARRAY(len_geometry, GeometryCache);
+        memset(geometry, 0, len_geometry * sizeof( GeometryCache ));
+
+        for (size_t i = 0; i < cache->len_geometry; i++) {
+            geometry[i].capacity = cache->geometry[i].capacity;
+            geometry[i].quads = cache->geometry[i].quads;
+        }
+
+        free(cache->geometry);
+        cache->geometry = geometry;
+        cache->len_geometry = len_geometry;
+    }
+
+    for (size_t i = 0; i < cache->len_geometry; i++) {
+        cache->geometry[i].valid = 0;
+    }
+
+    cache->num_ops = 0;
+    cache->valid = 1;
+    cache->serial = serial;
+}
+
+static GeometryCache *gl_cache_geometry(PageCache *cache, IGeometry *geo) {
+    if (geo->geo_id < 0 || (size_t) geo->geo_id >= cache->len_geometry) {
+        return NULL;
+    }
+
+    return &cache->geometry[geo->geo_id];
+}
+
+/*
+ * Copy the cached quads of the geometry into the 
+ * renderer, returns 0 if the cache is out of date.
+ */
+unsigned char gl_cache_draw(Renderer *r, PageCache *cache, IGeometry *geo) {
+    GeometryCache *c = gl_cache_geometry(cache, geo);
+
+    if (c == NULL || !c->valid || c->version != geo->version) {
+        return 0;
+    }
+
+    log_assert(r->count + c->count <= QUAD_CAP, "GL Renderer", "Too many quads");
+    memcpy(&r->quads[r->count], c->quads, c->count * sizeof( Quad ));
+    r->count += c->count;
+
+    return 1;
+}
+
+/*
+ * Store the quads added to the renderer since start
+ * as the quads of the geometry.
+ */
+void gl_cache_store(Renderer *r, PageCache *cache, IGeometry *geo, size_t start) {
+    GeometryCache *c = gl_cache_geometry(cache, geo);
+    size_t count = r->count - start;
+
+    if (c == NULL) {
+        return;
+    }
+
+    if (c->capacity < count) {
+        free(c->quads);
+        c->capacity = MAX(count, 2 * c->capacity);
+        c->quads = NEW_ARRAY(c->capacity, Quad);
+    }
+
+    memcpy(c->quads, &r->quads[start], count * sizeof( Quad ));
+    c->count = count;
+    c->version = geo->version;
+    c->valid = 1;
+}
@@ -1,41 +1,65 @@
 /*
  * gl_graph.c
  *
- * Setup and render a graph described by a 
+ * Setup and render a graph described by a
  * GeometryGraph in a GL context.
  *
+ * The lines of a graph are generated relative to the
+ * origin of the graph and kept in a vertex buffer,
+ * keyed by the data id of the graph, so a graph is
+ * only generated and uploaded again when its nodes
+ * or graph type change. A buffer holds the axis as
+ * a strip of 3 vertices, followed by the line strip
+ * of the graph.
+ *
+ * Bezier graphs are drawn as a Catmull-Rom spline
+ * through the nodes, each span is converted to a
+ * cubic bezier and split into GRAPH_CURVE_STEPS lines.
+ *
  */
 
 #include "gl_render_internal.h"
-#include <limits.h>
 
-static GLuint vao;
-static GLuint vbo;
-static GLuint ebo;
-static GLuint program;
+#define GRAPH_BUFFERS         32
+#define GRAPH_CURVE_STEPS     16
 
-static GLfloat *vertices     = NULL;
-static unsigned int *indices = NULL;
+typedef struct {
+    unsigned int data_id;
+    unsigned int last_used;
+    GLuint       vao;
+    GLuint       vbo;
+    size_t       capacity;
+    int          num_vertices;
+} GraphBuffer;
 
-static GLfloat axis_v[]      = { 
-    0.0f, 0.0f, 0.0f,
-    0.0f, 0.0f, 0.0f, 
-    0.0f, 0.0f, 0.0f,
-};
-static unsigned int axis_i[] = {
-    0, 1,
-    0, 2,
-};
-static int num_nodes = -1;
+static GraphBuffer buffers[GRAPH_BUFFERS];
+static unsigned int use_count = 0;
+
+static GLuint program;
+static GLint color_loc;
+static GLint translate_loc;
+
+static vec2 *vertices           = NULL;
+static size_t vertices_capacity = 0;
+static int num_vertices         = 0;
 
 void gl_graph_init_buffers(void) {
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ebo);
+    memset(buffers, 0, sizeof buffers);
+    use_count = 0;
+
+    for (int i = 0; i < GRAPH_BUFFERS; i++) {
+        glGenVertexArrays(1, &buffers[i].vao);
+        glGenBuffers(1, &buffers[i].vbo);
+
+        glBindVertexArray(buffers[i].vao);
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[i].vbo);
+
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof( vec2 ), (void *)0);
+        glEnableVertexAttribArray(0);
+    }
 
-    // bind the vertex array object
-    glBindVertexArray(vao);
     glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void gl_graph_init_shaders(void) {
@@ -43,6 +67,8 @@ void gl_graph_init_shaders(void) {
     GLuint fragment = gl_renderer_create_shader(GL_FRAGMENT_SHADER, glshape_fs_glsl);
 
     program = gl_renderer_create_program(vertex, fragment);
+    color_loc = glGetUniformLocation(program, "color");
+    translate_loc = glGetUniformLocation(program, "translate");
 
     glEnable(GL_LINE_SMOOTH);
     glHint(GL_LINE_SMOOTH_HINT,  GL_NICEST);
@@ -52,189 +78,168 @@ void gl_graph_init_shaders(void) {
     glDeleteShader(fragment);
 }
 
-static void gl_draw_axis(vec2 pos, vec2 offset) {
-    // find max for axis calc
-    int x_min = INT_MAX, x_max = INT_MIN;
-    int y_min = INT_MAX, y_max = INT_MIN;
-    for (int i = 0; i < num_nodes; i++) {
-        x_min = MIN(x_min, (int)vertices[3 * i]);
-        x_max = MAX(x_max, (int)vertices[3 * i]);
-        y_min = MIN(y_min, (int)vertices[3 * i + 1]);
-        y_max = MAX(y_max, (int)vertices[3 * i + 1]);
+static void gl_graph_reserve(size_t count) {
+    if (vertices_capacity >= count) {
+        return;
     }
 
-    // (0, 0) 
-    axis_v[0] = pos.x + offset.x;
-    axis_v[1] = pos.y + offset.y;
-
-    // x axis end
-    axis_v[3] = x_max + offset.x;
-    axis_v[4] = pos.y + offset.y;
-
-    // y axis end
-    axis_v[6] = pos.x + offset.x;
-    axis_v[7] = y_max + offset.y;
-
-    // draw axis
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof( axis_v ), axis_v, GL_STATIC_DRAW);
-
-    // bind and set element buffer
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof( axis_i ), axis_i, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof( float ), (void *)0);
-    glEnableVertexAttribArray(0);
+    vertices_capacity = MAX(count, 2 * vertices_capacity);
+    vertices = realloc(vertices, vertices_capacity * sizeof( vec2 ));
+    log_assert(vertices != NULL, "GL Renderer", "Unable to allocate graph vertices");
+}
 
-    glDrawElements(GL_LINES, 4, GL_UNSIGNED_INT, 0);
+static void gl_graph_add_vertex(float x, float y) {
+    vertices[num_vertices++] = (vec2){x, y};
 }
 
-static void gl_graph_gen_line(GeometryGraph *g, vec2 pos, vec2 offset) {
-    // number of nodes has changed, realloc arrays
-    if (num_nodes != g->num_nodes) {
-        free(vertices);
-        free(indices);
+static void gl_graph_gen_axis(GeometryGraph *g, int num_nodes, vec2 offset) {
+    int x_max = 0, y_max = 0;
 
-        num_nodes = g->num_nodes;
-        vertices = NEW_ARRAY(3 * num_nodes, GLfloat);
-        indices = NEW_ARRAY(2 * num_nodes, unsigned int);
+    for (int i = 0; i < num_nodes; i++) {
+        x_max = MAX(x_max, (int)g->nodes[i].x);
+        y_max = MAX(y_max, (int)g->nodes[i].y);
     }
 
+    // x axis end, (0, 0), y axis end
+    gl_graph_add_vertex(x_max + offset.x, 0);
+    gl_graph_add_vertex(0, 0);
+    gl_graph_add_vertex(0, y_max + offset.y);
+}
+
+static void gl_graph_gen_line(GeometryGraph *g, int num_nodes) {
     for (int i = 0; i < num_nodes; i++) {
-        vertices[3 * i]     = pos.x + offset.x + g->nodes[i].x;
-        vertices[3 * i + 1] = pos.y + offset.y + g->nodes[i].y;
-        vertices[3 * i + 2] = 0.0f;
-        
-        if (i < num_nodes - 1) {
-            indices[2 * i]     = i;
-            indices[2 * i + 1] = i + 1;
-        } else {
-            indices[2 * i]     = 0;
-            indices[2 * i + 1] = 0;
-        }
+        gl_graph_add_vertex(g->nodes[i].x, g->nodes[i].y);
     }
 }
 
-static void gl_graph_gen_bezier(GeometryGraph *g, vec2 pos, vec2 offset) {
-    // number of nodes has changed, realloc arrays
-    if (num_nodes != g->num_nodes) {
-        free(vertices);
-        free(indices);
-
-        num_nodes = g->num_nodes;
-        vertices = NEW_ARRAY(3 * num_nodes, GLfloat);
-        indices = NEW_ARRAY(2 * num_nodes, unsigned int);
+static void gl_graph_gen_bezier(GeometryGraph *g, int num_nodes) {
+    if (num_nodes < 2) {
+        gl_graph_gen_line(g, num_nodes);
+        return;
     }
-}
 
-static void gl_graph_gen_point(GeometryGraph *g, vec2 pos, vec2 offset) {
-    int node_x, node_y;
+    gl_graph_add_vertex(g->nodes[0].x, g->nodes[0].y);
 
-    // number of nodes has changed, realloc arrays
-    if (num_nodes != g->num_nodes) {
-        free(vertices);
-        free(indices);
+    for (int i = 0; i < num_nodes - 1; i++) {
+        vec2 p0 = g->nodes[MAX(i - 1, 0)];
+        vec2 p1 = g->nodes[i];
+        vec2 p2 = g->nodes[i + 1];
+        vec2 p3 = g->nodes[MIN(i + 2, num_nodes - 1)];
 
-        num_nodes = g->num_nodes;
-        vertices = NEW_ARRAY(3 * num_nodes, GLfloat);
-        indices = NEW_ARRAY(2 * num_nodes, unsigned int);
-    }
+        // bezier control points of the catmull-rom span p1 to p2
+        vec2 c1 = {p1.x + (p2.x - p0.x) / 6, p1.y + (p2.y - p0.y) / 6};
+        vec2 c2 = {p2.x - (p3.x - p1.x) / 6, p2.y - (p3.y - p1.y) / 6};
 
-    for (int i = 0; i < num_nodes; i++) {
-        node_x = g->nodes[i].x;
-        node_y = g->nodes[i].y;
-
-        vertices[3 * i]     = pos.x + offset.x + node_x;
-        vertices[3 * i + 1] = pos.y + offset.y + node_y;
-        vertices[3 * i + 2] = 0.0f;
-        
-        if (i < num_nodes - 1) {
-            indices[2 * i]     = i;
-            indices[2 * i + 1] = i + 1;
-        } else {
-            indices[2 * i]     = 0;
-            indices[2 * i + 1] = 0;
-        }
-    }
-}
+        for (int step = 1; step <= GRAPH_CURVE_STEPS; step++) {
+            float t = (float) step / GRAPH_CURVE_STEPS;
+            float s = 1 - t;
 
-static void gl_graph_gen_step(GeometryGraph *g, vec2 pos, vec2 offset) {
-    // number of nodes has changed, realloc arrays
-    if (num_nodes != 2 * g->num_nodes) {
-        free(vertices);
-        free(indices);
+            float b0 = s * s * s;
+            float b1 = 3 * s * s * t;
+            float b2 = 3 * s * t * t;
+            float b3 = t * t * t;
 
-        num_nodes = 2 * g->num_nodes;
-        vertices = NEW_ARRAY(3 * num_nodes, GLfloat);
-        indices = NEW_ARRAY(2 * num_nodes, unsigned int);
+            gl_graph_add_vertex(b0 * p1.x + b1 * c1.x + b2 * c2.x + b3 * p2.x,
+                                b0 * p1.y + b1 * c1.y + b2 * c2.y + b3 * p2.y);
+        }
     }
+}
 
-    for (int i = 0; i < g->num_nodes; i++) {
+static void gl_graph_gen_step(GeometryGraph *g, int num_nodes) {
+    for (int i = 0; i < num_nodes; i++) {
         // x = current point, y = last point
-        vertices[6 * i]     = pos.x + offset.x + g->nodes[i].x;
-        vertices[6 * i + 1] = pos.y + offset.y + g->nodes[MAX(i - 1, 0)].y;
-        vertices[6 * i + 2] = 0.0f;
+        gl_graph_add_vertex(g->nodes[i].x, g->nodes[MAX(i - 1, 0)].y);
 
         // current point
-        vertices[6 * i + 3] = pos.x + offset.x + g->nodes[i].x;
-        vertices[6 * i + 4] = pos.y + offset.y + g->nodes[i].y;
-        vertices[6 * i + 5] = 0.0f;
-        
-        indices[4 * i]     = MAX(2 * i - 2, 0);
-        indices[4 * i + 1] = MAX(2 * i - 1, 0);
-        indices[4 * i + 2] = MAX(2 * i - 1, 0);
-        indices[4 * i + 3] = 2 * i;
+        gl_graph_add_vertex(g->nodes[i].x, g->nodes[i].y);
     }
 }
 
-void gl_draw_graph(IGeometry *graph) {
-    GeometryGraph *geo_graph = (GeometryGraph *)graph;
-    int pos_x = geometry_get_int_attr(graph, GEO_POS_X);
-    int pos_y = geometry_get_int_attr(graph, GEO_POS_Y);
+/*
+ * Generate the vertices of the graph relative to
+ * the origin of the graph.
+ */
+static void gl_graph_gen_vertices(GeometryGraph *g, vec2 offset) {
+    int num_nodes = CLAMP(g->num_nodes, 0, MAX_GRAPH_NODES);
 
-    vec2 pos = {pos_x, pos_y};
-    vec2 offset = {20, 20};
+    num_vertices = 0;
+    gl_graph_reserve(3 + MAX(2, GRAPH_CURVE_STEPS) * (size_t) num_nodes + 1);
+    gl_graph_gen_axis(g, num_nodes, offset);
 
-    // generate vertices for the graph
-    switch (geo_graph->graph_type) {
+    switch (g->graph_type) {
         case LINE:
-            gl_graph_gen_line(geo_graph, pos, offset);
+        case POINT:
+            gl_graph_gen_line(g, num_nodes);
             break;
         case BEZIER:
-            gl_graph_gen_bezier(geo_graph, pos, offset);
-            break;
-        case POINT:
-            gl_graph_gen_point(geo_graph, pos, offset);
+            gl_graph_gen_bezier(g, num_nodes);
             break;
         case STEP:
-            gl_graph_gen_step(geo_graph, pos, offset);
+            gl_graph_gen_step(g, num_nodes);
             break;
         default:
-            log_file(LogWarn, "GL Renderer", "Unknown graph type %d", geo_graph->graph_type);
+            log_file(LogWarn, "GL Renderer", "Unknown graph type %d", g->graph_type);
     }
+}
 
-    gl_renderer_set_scale(program);
+/*
+ * Find the buffer holding the vertices of the graph,
+ * otherwise generate the vertices into the least
+ * recently used buffer.
+ */
+static GraphBuffer *gl_graph_buffer(GeometryGraph *g, vec2 offset) {
+    GraphBuffer *buf = &buffers[0];
 
-    glUseProgram(program);
-    glBindVertexArray(vao);
+    for (int i = 0; i < GRAPH_BUFFERS; i++) {
+        if (buffers[i].data_id == g->data_id) {
+            buffers[i].last_used = ++use_count;
+            return &buffers[i];
+        }
 
-    uint color_loc = glGetUniformLocation(program, "color");
-    glUniform4f(color_loc, geo_graph->color.x, geo_graph->color.y, geo_graph->color.z, geo_graph->color.w);
+        if (buffers[i].last_used < buf->last_used) {
+            buf = &buffers[i];
+        }
+    }
 
-    gl_draw_axis(pos, offset);
+    gl_graph_gen_vertices(g, offset);
 
-    // draw graph
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof( GLfloat ) * 3 * num_nodes, vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, buf->vbo);
+    if (buf->capacity < (size_t) num_vertices) {
+        buf->capacity = num_vertices;
+        glBufferData(GL_ARRAY_BUFFER, num_vertices * sizeof( vec2 ), vertices, GL_DYNAMIC_DRAW);
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, num_vertices * sizeof( vec2 ), vertices);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    buf->data_id = g->data_id;
+    buf->last_used = ++use_count;
+    buf->num_vertices = num_vertices;
+
+    return buf;
+}
+
+void gl_draw_graph(IGeometry *graph) {
+    GeometryGraph *geo_graph = (GeometryGraph *)graph;
+    int pos_x = geometry_get_int_attr(graph, GEO_POS_X);
+    int pos_y = geometry_get_int_attr(graph, GEO_POS_Y);
+
+    vec2 pos = {pos_x, pos_y};
+    vec2 offset = {20, 20};
 
-    // bind and set element buffer
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof( unsigned int ) * 2 * num_nodes, indices, GL_STATIC_DRAW);
+    GraphBuffer *buf = gl_graph_buffer(geo_graph, offset);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof( float ), (void *)0);
-    glEnableVertexAttribArray(0);
+    glUseProgram(program);
+    glBindVertexArray(buf->vao);
+
+    glUniform4f(color_loc, geo_graph->color.x, geo_graph->color.y, geo_graph->color.z, geo_graph->color.w);
+    glUniform2f(translate_loc, pos.x + offset.x, pos.y + offset.y);
 
-    glDrawElements(GL_LINES, 2 * (num_nodes + 2), GL_UNSIGNED_INT, 0);
+    // axis then graph
+    glDrawArrays(GL_LINE_STRIP, 0, 3);
+    if (buf->num_vertices > 4) {
+        glDrawArrays(GL_LINE_STRIP, 3, buf->num_vertices - 3);
+    }
 
     glBindVertexArray(0);
     glUseProgram(0);
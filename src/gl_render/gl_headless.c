@@ -0,0 +1,294 @@
+/*
+ * gl_headless.c
+ *
+ * Offscreen renderer for running the gl_render
+ * pipeline without a GtkGLArea, e.g. on build
+ * hosts without a GPU (llvmpipe).
+ *
+ * gl_headless_init creates a surfaceless EGL
+ * context and a framebuffer object with a color
+ * and stencil attachment. gl_headless_render then
+ * renders frames into the framebuffer at a fixed
+ * CHROMA_FRAMERATE clock, logs a checksum of each
+ * frame and optionally dumps each frame as a ppm.
+ *
+ */
+
+#include "gl_render_internal.h"
+#include "gl_render.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <time.h>
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLContext context = EGL_NO_CONTEXT;
+
+static GLuint fbo;
+static GLuint color_rb;
+static GLuint stencil_rb;
+
+static int fbo_width;
+static int fbo_height;
+static unsigned char *pixels = NULL;
+
+static EGLDisplay gl_headless_display(void) {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    if (get_platform_display != NULL) {
+        EGLDisplay d = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (d != EGL_NO_DISPLAY) {
+            return d;
+        }
+    }
+
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+/*
+ * Release the framebuffer, context and display, 
+ * whichever have been created, so a failed init 
+ * and gl_headless_free share one cleanup path.
+ */
+static void gl_headless_release(void) {
+    if (fbo != 0) {
+        glDeleteRenderbuffers(1, &stencil_rb);
+        glDeleteRenderbuffers(1, &color_rb);
+        glDeleteFramebuffers(1, &fbo);
+
+        fbo = color_rb = stencil_rb = 0;
+    }
+
+    if (display == EGL_NO_DISPLAY) {
+        return;
+    }
+
+    if (context != EGL_NO_CONTEXT) {
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, context);
+    }
+
+    eglTerminate(display);
+
+    display = EGL_NO_DISPLAY;
+    context = EGL_NO_CONTEXT;
+}
+
+int gl_headless_init(int width, int height) {
+    EGLint major, minor, num_config;
+    EGLConfig config;
+
+    display = gl_headless_display();
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        log_file(LogWarn, "GL Headless", "Unable to initialise EGL display");
+        gl_headless_release();
+        return -1;
+    }
+
+    log_file(LogMessage, "GL Headless", "EGL %d.%d", major, minor);
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        log_file(LogWarn, "GL Headless", "EGL does not support OpenGL");
+        gl_headless_release();
+        return -1;
+    }
+
+    EGLint config_attr[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+
+    if (!eglChooseConfig(display, config_attr, &config, 1, &num_config) || num_config == 0) {
+        log_file(LogWarn, "GL Headless", "No EGL config found");
+        gl_headless_release();
+        return -1;
+    }
+
+    EGLint context_attr[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attr);
+    if (context == EGL_NO_CONTEXT) {
+        log_file(LogWarn, "GL Headless", "Unable to create EGL context (0x%x)", eglGetError());
+        gl_headless_release();
+        return -1;
+    }
+
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        log_file(LogWarn, "GL Headless", "Unable to make EGL context current (0x%x)", eglGetError());
+        gl_headless_release();
+        return -1;
+    }
+
+    // glew uses glx to check extensions, which fails without
+    // an X display, but the function pointers are still loaded
+    glewExperimental = GL_TRUE;
+    GLenum glew_err = glewInit();
+
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    if (glew_err == GLEW_ERROR_NO_GLX_DISPLAY) {
+        glew_err = GLEW_OK;
+    }
+#endif
+
+    if (glew_err != GLEW_OK) {
+        log_file(LogWarn, "GL Headless", "Unable to load GL functions (%s)", glewGetErrorString(glew_err));
+        gl_headless_release();
+        return -1;
+    }
+
+    log_file(LogMessage, "GL Headless", "Renderer %s, version %s",
+             glGetString(GL_RENDERER), glGetString(GL_VERSION));
+
+    fbo_width = width;
+    fbo_height = height;
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+    glGenRenderbuffers(1, &color_rb);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_rb);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_rb);
+
+    glGenRenderbuffers(1, &stencil_rb);
+    glBindRenderbuffer(GL_RENDERBUFFER, stencil_rb);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, stencil_rb);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        log_file(LogWarn, "GL Headless", "Framebuffer incomplete");
+        gl_headless_release();
+        return -1;
+    }
+
+    glViewport(0, 0, width, height);
+    pixels = NEW_ARRAY(4 * width * height, unsigned char);
+
+    gl_render_init();
+    return 0;
+}
+
+/*
+ * FNV-1a hash of the frame, used to detect
+ * render regressions between builds.
+ */
+static uint64_t gl_headless_checksum(unsigned char *data, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3;
+    }
+
+    return hash;
+}
+
+static void gl_headless_dump_frame(char *dump_path, int frame, unsigned char *data) {
+    char file_name[MAX_BUF_SIZE];
+    snprintf(file_name, sizeof file_name, "%s/frame_%05d.ppm", dump_path, frame);
+
+    FILE *file = fopen(file_name, "wb");
+    if (file == NULL) {
+        log_file(LogWarn, "GL Headless", "Unable to open %s", file_name);
+        return;
+    }
+
+    fprintf(file, "P6\n%d %d\n255\n", fbo_width, fbo_height);
+
+    // gl rows start at the bottom of the frame
+    for (int y = fbo_height - 1; y >= 0; y--) {
+        for (int x = 0; x < fbo_width; x++) {
+            fwrite(&data[4 * (y * fbo_width + x)], 1, 3, file);
+        }
+    }
+
+    fclose(file);
+}
+
+static double gl_headless_elapsed_ms(struct timespec *start, struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/*
+ * Render num_frames frames, one every 1 / CHROMA_FRAMERATE
+ * seconds. If dump_path is not empty, each frame is
+ * written to dump_path/frame_n.ppm and the checksums
+ * to dump_path/checksums.txt.
+ */
+void gl_headless_render(int num_frames, char *dump_path) {
+    struct timespec next, start, end;
+    long frame_ns = 1000000000L / CHROMA_FRAMERATE;
+    double frame_ms, total_ms = 0, max_ms = 0;
+    size_t frame_size = 4 * fbo_width * fbo_height;
+    FILE *checksums = NULL;
+
+    if (dump_path != NULL && strlen(dump_path) > 0) {
+        char file_name[MAX_BUF_SIZE];
+        snprintf(file_name, sizeof file_name, "%s/checksums.txt", dump_path);
+
+        checksums = fopen(file_name, "w");
+        if (checksums == NULL) {
+            log_file(LogWarn, "GL Headless", "Unable to open %s", file_name);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    for (int frame = 0; frame < num_frames; frame++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        // the framebuffer still holds the last frame if idle
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        if (gl_render_needs_frame()) {
+            gl_render_frame();
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        frame_ms = gl_headless_elapsed_ms(&start, &end);
+        total_ms += frame_ms;
+        max_ms = MAX(max_ms, frame_ms);
+
+        glReadPixels(0, 0, fbo_width, fbo_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        uint64_t checksum = gl_headless_checksum(pixels, frame_size);
+
+        log_file(LogMessage, "GL Headless", "Frame %d: checksum %016" PRIx64 ", %f ms", frame, checksum, frame_ms);
+
+        if (checksums != NULL) {
+            fprintf(checksums, "%d %016" PRIx64 "\n", frame, checksum);
+            gl_headless_dump_frame(dump_path, frame, pixels);
+        }
+
+        // fixed clock, independent of how long the frame took
+        next.tv_nsec += frame_ns;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+
+    if (checksums != NULL) {
+        fclose(checksums);
+    }
+
+    if (num_frames > 0) {
+        log_file(LogMessage, "GL Headless", "Rendered %d frames, avg %f ms, max %f ms",
+                 num_frames, total_ms / num_frames, max_ms);
+    }
+}
+
+void gl_headless_free(void) {
+    free(pixels);
+    pixels = NULL;
+
+    gl_headless_release();
+}
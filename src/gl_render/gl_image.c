@@ -4,6 +4,10 @@
  * Setup and render an image described by a 
  * GeometryImage in a GL context.
  *
+ * Each image asset is uploaded to its own texture
+ * the first time it is drawn, and uploaded again
+ * only when the version of the asset changes.
+ *
  */
 
 #include "gl_render_internal.h"
@@ -11,9 +15,15 @@
 static GLuint vao;
 static GLuint vbo;
 static GLuint ebo;
-static GLuint texture;
 static GLuint program;
 
+typedef struct {
+    GLuint texture;
+    int    version;
+} ImageTexture;
+
+static ImageTexture textures[MAX_ASSETS];
+
 static GLuint indices[] = {
     0, 1, 3, // first triangle 
     1, 2, 3, // second triangle
@@ -55,24 +65,52 @@ void gl_image_init_shaders(void) {
 
     program = gl_renderer_create_program(vertex, fragment);
 
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+}
+
+/*
+ * Texture of the image asset, uploading the image
+ * data if the cached texture is missing or stale.
+ * The asset is read from the hub holding img_lock,
+ * as the parser may replace the data.
+ */
+static GLuint gl_image_texture(GeometryImage *img) {
+    ImageTexture *tex = &textures[img->image_id];
+    Image *asset = &engine.hub.img[img->image_id];
+
+    g_mutex_lock(&engine.hub.img_lock);
+    if (asset->data == NULL || (tex->texture != 0 && tex->version == asset->version)) {
+        g_mutex_unlock(&engine.hub.img_lock);
+        return tex->texture;
+    }
+
+    if (tex->texture == 0) {
+        glGenTextures(1, &tex->texture);
+        glBindTexture(GL_TEXTURE_2D, tex->texture);
 
-    // texture wrapping
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        // texture wrapping
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
 
-    float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+        float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
 
-    // texture filtering
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        // texture filtering
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, tex->texture);
+    }
 
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, asset->w, asset->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, asset->data);
+    glGenerateMipmap(GL_TEXTURE_2D);
     glBindTexture(GL_TEXTURE_2D, 0);
 
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    tex->version = asset->version;
+    g_mutex_unlock(&engine.hub.img_lock);
+
+    return tex->texture;
 }
 
 void gl_draw_image(IGeometry *geo) {
@@ -84,6 +122,13 @@ void gl_draw_image(IGeometry *geo) {
         return;
     }
 
+    if (img->image_id < 0 || img->image_id >= MAX_ASSETS) {
+        log_file(LogWarn, "GL Renderer", "Image id %d out of range", img->image_id);
+        return;
+    }
+
+    GLuint texture = gl_image_texture(img);
+
     char buf[100];
     memset(buf, '\0', sizeof( buf ));
     geometry_get_attr(geo, "scale", buf);
@@ -97,8 +142,6 @@ void gl_draw_image(IGeometry *geo) {
         pos_x,                  pos_y + img->h * scale, 0.0f,   1.0f, 1.0f, 0.0f,   0.0f, 1.0f, // bottom right
     };
 
-    gl_renderer_set_scale(program);
-
     glUseProgram(program);
     glBindVertexArray(vao);
 
@@ -107,9 +150,6 @@ void gl_draw_image(IGeometry *geo) {
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, img->w, img->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, img->data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
     glBindTexture(GL_TEXTURE_2D, 0);
@@ -0,0 +1,161 @@
+/*
+ * gl_layer.c
+ *
+ * Offscreen framebuffers for each layer.
+ *
+ * Each layer is drawn into its own texture, which
+ * is kept between frames, so a layer whose page
+ * has not changed is not drawn again. The layers
+ * are then composited in order onto the target
+ * framebuffer with a full screen triangle each.
+ *
+ * Layers store premultiplied color, blending into
+ * a layer uses the alpha of the source for the
+ * color and the 'over' operator for the alpha, so
+ * compositing with GL_ONE, GL_ONE_MINUS_SRC_ALPHA
+ * matches drawing the layers straight to the target.
+ *
+ */
+
+#include "gl_render_internal.h"
+
+typedef struct {
+    GLuint fbo;
+    GLuint texture;
+    GLuint stencil_rb;
+} LayerBuffer;
+
+static LayerBuffer layers[CHROMA_LAYERS];
+static int layer_width = 0;
+static int layer_height = 0;
+
+static GLuint vao;
+static GLuint program;
+
+void gl_layer_init(void) {
+    GLuint vertex = gl_renderer_create_shader(GL_VERTEX_SHADER, glcomposite_vs_glsl);
+    GLuint fragment = gl_renderer_create_shader(GL_FRAGMENT_SHADER, glcomposite_fs_glsl);
+
+    program = gl_renderer_create_program(vertex, fragment);
+
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "layer"), 0);
+    glUseProgram(0);
+
+    // vertices are generated from gl_VertexID
+    glGenVertexArrays(1, &vao);
+
+    memset(layers, 0, sizeof layers);
+    layer_width = 0;
+    layer_height = 0;
+}
+
+static void gl_layer_free(LayerBuffer *buf) {
+    if (buf->fbo == 0) {
+        return;
+    }
+
+    glDeleteFramebuffers(1, &buf->fbo);
+    glDeleteTextures(1, &buf->texture);
+    glDeleteRenderbuffers(1, &buf->stencil_rb);
+    memset(buf, 0, sizeof( LayerBuffer ));
+}
+
+static void gl_layer_create(LayerBuffer *buf) {
+    glGenTextures(1, &buf->texture);
+    glBindTexture(GL_TEXTURE_2D, buf->texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, layer_width, layer_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &buf->stencil_rb);
+    glBindRenderbuffer(GL_RENDERBUFFER, buf->stencil_rb);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, layer_width, layer_height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &buf->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, buf->fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, buf->texture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, buf->stencil_rb);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        log_file(LogWarn, "GL Layer", "Layer framebuffer incomplete");
+    }
+}
+
+/*
+ * Match the layer buffers to the size of the target,
+ * returns 1 if the layers were discarded and need
+ * to be drawn again.
+ */
+unsigned char gl_layer_resize(int width, int height) {
+    if (width == layer_width && height == layer_height) {
+        return 0;
+    }
+
+    for (int layer = 0; layer < CHROMA_LAYERS; layer++) {
+        gl_layer_free(&layers[layer]);
+    }
+
+    layer_width = width;
+    layer_height = height;
+    return 1;
+}
+
+/*
+ * Bind and clear the buffer of the layer, the
+ * buffer is created on the first use of the layer.
+ */
+void gl_layer_begin(int layer) {
+    LayerBuffer *buf = &layers[layer];
+
+    if (buf->fbo == 0) {
+        gl_layer_create(buf);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, buf->fbo);
+    glViewport(0, 0, layer_width, layer_height);
+
+    glClearColor(0, 0, 0, 0);
+    glClearStencil(0);
+    glStencilMask(0xFF);
+    glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+}
+
+/*
+ * Draw the buffer of the layer over the target
+ * framebuffer, which should have the same size.
+ */
+void gl_layer_composite(GLuint target, int layer) {
+    LayerBuffer *buf = &layers[layer];
+
+    if (buf->fbo == 0) {
+        return;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+
+    glDisable(GL_STENCIL_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    glUseProgram(program);
+    glBindVertexArray(vao);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, buf->texture);
+
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_STENCIL_TEST);
+}
@@ -5,9 +5,11 @@
  */
 
 #include "gl_render_internal.h"
+#include "gl_render.h"
 #include "chroma-typedefs.h"
 #include "glib.h"
 #include <gtk/gtk.h>
+#include <limits.h>
 
 #define ANIM_LENGTH     120
 
@@ -19,6 +21,24 @@ int frame_num[] = {0, 0, 0, 0, 0};
 float frame_time[] = {0.0, 0.0, 0.0, 0.0, 0.0};
 
 Renderer r;
+static PageCache layer_cache[CHROMA_LAYERS];
+static GLuint projection_ubo;
+
+/*
+ * State of a layer when the last frame was drawn,
+ * see gl_render_needs_frame.
+ */
+typedef struct {
+    int page_num;
+    int action;
+    int frame_num;
+    float frame_time;
+    unsigned int serial;
+} LayerState;
+
+static LayerState drawn_layer[CHROMA_LAYERS];
+static int drawn_valid = 0;
+static int drawn_perf = 0;
 
 /* Create and compile a shader */
 GLuint gl_renderer_create_shader(int type, const char *src) {
@@ -75,12 +95,54 @@ GLuint gl_renderer_create_program(GLuint vertex, GLuint fragment) {
         g_free(buffer);
 
         glDeleteProgram(program);
-        program = 0;
+        return 0;
+    }
+
+    // programs read the projection from the shared uniform buffer
+    GLuint block = glGetUniformBlockIndex(program, "Projection");
+    if (block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, block, PROJECTION_BINDING);
     }
 
     return program;
 }
 
+/*
+ * Create the uniform buffer holding the model, view
+ * and ortho matrices shared by every program.
+ */
+static void gl_renderer_init_projection(void) {
+    GLfloat projection[3][16] = {
+        GL_MATH_ID,
+        GL_MATH_TRANSLATE(0, 0, -1),
+        GL_MATH_ORTHO(0.0, 1920.0, 0.0, 1080.0, -1.0, 1.0),
+    };
+
+    glGenBuffers(1, &projection_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, projection_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof projection, projection, GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/*
+ * Bind the projection for every program, called 
+ * once per frame.
+ */
+void gl_renderer_bind_projection(void) {
+    glBindBufferBase(GL_UNIFORM_BUFFER, PROJECTION_BINDING, projection_ubo);
+}
+
+/*
+ * Only queue a render when the frame would differ
+ * from the last one, otherwise GTK keeps showing 
+ * the previous framebuffer.
+ */
+static void gl_render_update(GdkFrameClock *frame_clock, GtkWidget *widget) {
+    if (gl_render_needs_frame()) {
+        gtk_gl_area_queue_render(GTK_GL_AREA(widget));
+    }
+}
+
 void gl_realize(GtkWidget *widget) {
     GdkFrameClock *frame_clock;
     gtk_gl_area_make_current(GTK_GL_AREA(widget));
@@ -88,42 +150,38 @@ void gl_realize(GtkWidget *widget) {
 
     // tie render to frame clock
     frame_clock = gtk_widget_get_frame_clock(widget);
-    g_signal_connect_swapped(frame_clock, "update", G_CALLBACK(gtk_gl_area_queue_render), widget);
+    g_signal_connect(frame_clock, "update", G_CALLBACK(gl_render_update), widget);
     gdk_frame_clock_begin_updating(frame_clock);
 
+    gl_render_init();
+}
+
+/*
+ * Initialize gl state, buffers and shaders in 
+ * the current context. Shared by the GtkGLArea
+ * and headless renderers.
+ */
+void gl_render_init(void) {
     glEnable(GL_STENCIL_TEST);
     glStencilOp(GL_REPLACE, GL_KEEP, GL_KEEP);
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    gl_renderer_init_projection();
+    gl_layer_init();
 
     gl_graph_init_buffers();
     gl_graph_init_shaders();
 
-    gl_text_init_buffers();
-    gl_text_init_shaders();
-    gl_text_cache_characters();
-
     gl_image_init_buffers();
     gl_image_init_shaders();
 
     gl_renderer_triangle_init(&r, glrender_vs_glsl, glrender_fs_glsl);                             
-}
-
-void gl_renderer_set_scale(GLuint program) {
-    glUseProgram(program);
+    gl_text_cache_characters(&r);
 
-    GLfloat view[] = GL_MATH_TRANSLATE(0, 0, -1);
-    GLfloat model[] = GL_MATH_ID;
-    GLfloat ortho[] = GL_MATH_ORTHO(0.0, 1920.0, 0.0, 1080.0, -1.0, 1.0);
-
-    uint model_loc = glGetUniformLocation(program, "model");
-    glUniformMatrix4fv(model_loc, 1, GL_TRUE, model);
-
-    uint view_loc = glGetUniformLocation(program, "view");
-    glUniformMatrix4fv(view_loc, 1, GL_TRUE, view);
-
-    uint ortho_loc = glGetUniformLocation(program, "ortho");
-    glUniformMatrix4fv(ortho_loc, 1, GL_TRUE, ortho);
+    drawn_valid = 0;
 }
 
+
 static float gl_bezier_time_step(float time, float start, float end, int order) {
     if (order == 1) {
         return (1 - time) * start + time * end;
@@ -146,7 +204,7 @@ static void gl_render_draw_geometry(Renderer *r, IGeometry *geo) {
             break;
 
         case TEXT:
-            gl_draw_text(geo);
+            gl_draw_text(r, (GeometryText *)geo);
             break;
 
         case GRAPH:
@@ -166,112 +224,334 @@ static void gl_render_draw_geometry(Renderer *r, IGeometry *geo) {
     }
 }
 
-static int gl_render_has_child(IPage *page, int geo_num) {
-    IGeometry *geo;
-    int retval = 0;
+/*
+ * Page drawing
+ *
+ * The hierarchy of a snapshot is compiled into a list
+ * of ops once per snapshot, by gl_render_compile_heirachy. 
+ * Children of a geometry are drawn unmasked then masked 
+ * by the stencil bits of their ancestors, then each 
+ * child with children writes its own stencil bit and 
+ * the children are drawn recursively.
+ *
+ * Equivalent stencil states are merged, so consecutive
+ * passes with the same state are drawn together and a 
+ * pass without geometry is skipped. A stencil bit is 
+ * cleared with a scissored clear of the region written
+ * since the last clear, instead of a full screen draw.
+ */
 
-    for (size_t i = 0; i < page->len_geometry; i++) {
-        geo = page->geometry[i];
-        if (geo == NULL) {
-            continue;
-        }
+#define RENDER_MAX_DEPTH    8
 
-        if (geo->parent_id != geo_num) {
-            continue;
-        }
+typedef struct {
+    int x0, y0, x1, y1;
+} RenderBox;
+
+static RenderBox stencil_dirty[RENDER_MAX_DEPTH];
+static GLint viewport[4];
+
+/*
+ * Draw geometry from the cache of the page if it has 
+ * not changed, graphs and images are not batched.
+ */
+static void gl_render_draw_cached(Renderer *r, PageCache *cache, IGeometry *geo) {
+    size_t start = r->count;
+
+    if (geo->geo_type == GRAPH || geo->geo_type == IMAGE) {
+        gl_render_draw_geometry(r, geo);
+        return;
+    }
 
-        retval = 1;
+    if (gl_cache_draw(r, cache, geo)) {
+        return;
     }
 
-    return retval;
+    gl_render_draw_geometry(r, geo);
+    gl_cache_store(r, cache, geo, start);
+}
+
+static int gl_render_has_child(PageSnapshot *page, int geo_num) {
+    return page->child_offset[geo_num + 1] > page->child_offset[geo_num];
 }
 
-static void gl_render_clear_bit(IPage *page, uint depth) {
-    GeometryRect rect = {{RECT, 0, 0, {0, 0}, {0, 0}, 0}, 1920, 1080, 0, {0, 0, 0, 0}};
+/*
+ * Stencil states with the same effect map to the
+ * same key, masked drawing at depth 0 tests no bits.
+ */
+static int gl_render_state_key(RendererOptions opt, int depth) {
+    if (opt == RENDER_DRAW_NO_MASK || (opt == RENDER_DRAW_MASK && depth == 0)) {
+        return -1;
+    }
+
+    return opt * RENDER_MAX_DEPTH + depth;
+}
 
-    gl_renderer_mask(&r, RENDER_MASK_CLEAR, depth);
+static RenderOp *gl_render_add_op(PageCache *cache, RenderOpType type) {
+    if (cache->num_ops == cache->ops_capacity) {
+        cache->ops_capacity = MAX(2 * cache->ops_capacity, 64);
+        cache->ops = realloc(cache->ops, cache->ops_capacity * sizeof( RenderOp ));
+    }
 
-    gl_draw_rectangle(&r, &rect);
+    RenderOp *op = &cache->ops[cache->num_ops++];
+    memset(op, 0, sizeof( RenderOp ));
+    op->type = type;
 
-    gl_renderer_use(&r);
-    gl_renderer_draw(&r);
+    return op;
 }
 
-static void gl_render_draw_heirachy(IPage *page, IGeometry *parent, uint depth) {
-    IGeometry *geo;
-    log_assert(depth < 8, "GL Render", "Renderer has 8 stencil buffers");
+static void gl_render_add_state(PageCache *cache, RendererOptions opt, int depth) {
+    RenderOp *last = (cache->num_ops > 0) ? &cache->ops[cache->num_ops - 1] : NULL;
+    int key = gl_render_state_key(opt, depth);
 
-    // draw child geometries without mask
-    gl_renderer_mask(&r, RENDER_DRAW_NO_MASK, depth);
-    for (int geo_num = 0; geo_num < page->len_geometry; geo_num++) {
-        geo = page->geometry[geo_num];
-        if (geo == NULL) {
-            continue;
-        }
+    // a state with no draws is replaced
+    if (last != NULL && last->type == RENDER_OP_STATE) {
+        cache->num_ops--;
+        last = (cache->num_ops > 0) ? &cache->ops[cache->num_ops - 1] : NULL;
+    }
 
-        if (geo->parent_id != parent->geo_id) {
-            continue;
-        }
+    // find the state in effect 
+    for (size_t i = cache->num_ops; i > 0; i--) {
+        RenderOp *op = &cache->ops[i - 1];
 
-        if (geo->mask_geo) {
-            continue;
+        if (op->type == RENDER_OP_CLEAR) {
+            break;
         }
 
-        gl_render_draw_geometry(&r, geo);
+        if (op->type == RENDER_OP_STATE) {
+            if (gl_render_state_key(op->opt, op->depth) == key) {
+                return;
+            }
+
+            break;
+        }
     }
 
-    gl_renderer_use(&r);
-    gl_renderer_draw(&r);
+    RenderOp *op = gl_render_add_op(cache, RENDER_OP_STATE);
+    op->opt = opt;
+    op->depth = depth;
+}
+
+static void gl_render_add_draw(PageCache *cache, int geo_num) {
+    RenderOp *op = gl_render_add_op(cache, RENDER_OP_DRAW);
+    op->geo_num = geo_num;
+}
+
+static void gl_render_compile_heirachy(PageSnapshot *page, PageCache *cache, int parent, int depth) {
+    size_t start = page->child_offset[parent];
+    size_t mask = page->mask_offset[parent];
+    size_t end = page->child_offset[parent + 1];
+    log_assert(depth < RENDER_MAX_DEPTH, "GL Render", "Renderer has 8 stencil buffers");
+
+    // draw child geometries without mask
+    gl_render_add_state(cache, RENDER_DRAW_NO_MASK, depth);
+    for (size_t i = start; i < mask; i++) {
+        gl_render_add_draw(cache, page->draw[i]);
+    }
 
     // draw child geometries with mask
-    gl_renderer_mask(&r, RENDER_DRAW_MASK, depth);
-    for (int geo_num = 0; geo_num < page->len_geometry; geo_num++) {
-        geo = page->geometry[geo_num];
-        if (geo == NULL) {
-            continue;
-        }
+    gl_render_add_state(cache, RENDER_DRAW_MASK, depth);
+    for (size_t i = mask; i < end; i++) {
+        gl_render_add_draw(cache, page->draw[i]);
+    }
 
-        if (geo->parent_id != parent->geo_id) {
-            continue;
-        }
+    for (size_t i = start; i < end; i++) {
+        int geo_num = page->child[i];
 
-        if (!geo->mask_geo) {
+        if (!gl_render_has_child(page, geo_num)) {
             continue;
         }
 
-        gl_render_draw_geometry(&r, geo);
+        RenderOp *op = gl_render_add_op(cache, RENDER_OP_CLEAR);
+        op->depth = depth;
+
+        gl_render_add_state(cache, RENDER_MASK, depth);
+        gl_render_add_draw(cache, geo_num);
+
+        gl_render_compile_heirachy(page, cache, geo_num, depth + 1);
+    }
+}
+
+static void gl_render_flush(void) {
+    if (r.count == 0) {
+        return;
     }
 
     gl_renderer_use(&r);
     gl_renderer_draw(&r);
+}
 
-    for (int geo_num = 0; geo_num < page->len_geometry; geo_num++) {
-        geo = page->geometry[geo_num];
-        if (geo == NULL) {
-            continue;
+/*
+ * Grow the dirty region of a stencil bit to cover
+ * the quads from start, in window coordinates.
+ */
+static void gl_render_mark_stencil(int depth, size_t start) {
+    RenderBox *box = &stencil_dirty[depth];
+
+    for (size_t i = start; i < r.count; i++) {
+        for (int j = 0; j < 4; j++) {
+            vec2 pos = r.quads[i].v[j].pos;
+            int x = viewport[0] + pos.x * viewport[2] / 1920.0f;
+            int y = viewport[1] + pos.y * viewport[3] / 1080.0f;
+
+            box->x0 = MIN(box->x0, x - 1);
+            box->y0 = MIN(box->y0, y - 1);
+            box->x1 = MAX(box->x1, x + 2);
+            box->y1 = MAX(box->y1, y + 2);
         }
+    }
+}
 
-        if (geo->parent_id != parent->geo_id) {
-            continue;
-        }
+static void gl_render_clear_dirty(void) {
+    for (int i = 0; i < RENDER_MAX_DEPTH; i++) {
+        stencil_dirty[i] = (RenderBox){INT_MAX, INT_MAX, INT_MIN, INT_MIN};
+    }
+}
 
-        if (!gl_render_has_child(page, geo_num)) {
-            continue;
+static void gl_render_clear_bit(int depth) {
+    RenderBox *box = &stencil_dirty[depth];
+
+    if (box->x0 >= box->x1 || box->y0 >= box->y1) {
+        return;
+    }
+
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(box->x0, box->y0, box->x1 - box->x0, box->y1 - box->y0);
+    glStencilMask(1 << depth);
+    glClear(GL_STENCIL_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+
+    *box = (RenderBox){INT_MAX, INT_MAX, INT_MIN, INT_MIN};
+}
+
+static void gl_render_draw_page(PageSnapshot *page, PageCache *cache) {
+    RendererOptions opt = RENDER_DRAW_NO_MASK;
+    int depth = 0;
+
+    if (cache->num_ops == 0 || page->keyframed_hierarchy) {
+        cache->num_ops = 0;
+        gl_render_compile_heirachy(page, cache, 0, 0);
+    }
+
+    for (size_t i = 0; i < cache->num_ops; i++) {
+        RenderOp *op = &cache->ops[i];
+        IGeometry *geo;
+        size_t start;
+
+        switch (op->type) {
+            case RENDER_OP_STATE:
+                gl_render_flush();
+
+                opt = op->opt;
+                depth = op->depth;
+                gl_renderer_mask(&r, opt, depth);
+                break;
+
+            case RENDER_OP_DRAW:
+                geo = page->geometry[op->geo_num];
+                start = r.count;
+
+                // graphs and images draw immediately 
+                if (geo->geo_type == GRAPH || geo->geo_type == IMAGE) {
+                    gl_render_flush();
+
+                    if (opt == RENDER_MASK) {
+                        stencil_dirty[depth] = (RenderBox){viewport[0], viewport[1], 
+                            viewport[0] + viewport[2], viewport[1] + viewport[3]};
+                    }
+                }
+
+                gl_render_draw_cached(&r, cache, geo);
+
+                if (opt == RENDER_MASK) {
+                    gl_render_mark_stencil(depth, start);
+                }
+                break;
+
+            case RENDER_OP_CLEAR:
+                gl_render_flush();
+                gl_render_clear_bit(op->depth);
+                break;
         }
+    }
 
-        gl_render_clear_bit(page, depth);
+    gl_render_flush();
+}
 
-        gl_renderer_mask(&r, RENDER_MASK, depth);
-        gl_render_draw_geometry(&r, geo);
+static unsigned char gl_render_layer_changed(LayerState *state, LayerState *next) {
+    return state->page_num != next->page_num 
+        || state->action != next->action
+        || state->frame_num != next->frame_num
+        || state->frame_time != next->frame_time
+        || state->serial != next->serial;
+}
 
-        gl_renderer_use(&r);
-        gl_renderer_draw(&r);
+/*
+ * A frame is needed if a layer has changed page or
+ * action, its animation has advanced, or its page 
+ * has been published since the last frame was drawn.
+ * Layers in a settled state are otherwise unchanged,
+ * so the previous frame can be reused.
+ */
+int gl_render_needs_frame(void) {
+    int needs_frame = !drawn_valid;
+
+    g_mutex_lock(&engine.lock);
+    needs_frame |= engine.render_perf || drawn_perf;
+    g_mutex_unlock(&engine.lock);
+
+    if (needs_frame) {
+        return 1;
+    }
+
+    graphics_snapshot_begin_read();
+    g_mutex_lock(&gl_lock);
+
+    for (int layer = 0; layer < CHROMA_LAYERS && !needs_frame; layer++) {
+        LayerState state = {
+            .page_num = page_num[layer],
+            .action = action[layer],
+            .frame_num = frame_num[layer],
+            .frame_time = frame_time[layer],
+            .serial = 0,
+        };
+
+        if (page_num[layer] >= 0) {
+            IPage *page = graphics_hub_get_page(&engine.hub, page_num[layer]);
+            PageSnapshot *snap = (page == NULL) ? NULL : graphics_page_snapshot(page);
+
+            if (snap != NULL) {
+                state.serial = snap->serial;
+            }
+        }
 
-        gl_render_draw_heirachy(page, geo, depth + 1);
+        needs_frame = gl_render_layer_changed(&drawn_layer[layer], &state);
     }
+
+    g_mutex_unlock(&gl_lock);
+    graphics_snapshot_end_read();
+
+    return needs_frame;
 }
 
 gboolean gl_render(GtkGLArea *area, GdkGLContext *context) {
+    gl_render_frame();
+    return TRUE;
+}
+
+/*
+ * Render each layer to the currently bound 
+ * framebuffer, advancing the animation of 
+ * each layer by one frame.
+ *
+ * Layers are drawn into their own buffer, see
+ * gl_layer.c, and only drawn again when the layer
+ * has changed since it was last drawn. 
+ *
+ * Pages are drawn from their published snapshot,
+ * so the render thread never waits on a page lock
+ * held by a parser thread.
+ */
+void gl_render_frame(void) {
     static double render_time = 0;
     static GeometryText render_text = {
         .geo = {
@@ -285,27 +565,64 @@ gboolean gl_render(GtkGLArea *area, GdkGLContext *context) {
     };
 
     float time, bezier_time;
+    float layer_time[CHROMA_LAYERS];
+    PageSnapshot *layer_page[CHROMA_LAYERS];
     IPage *page;
-    glClearColor(0, 0, 0, 0);
-    glClearStencil(0);
-    glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    PageSnapshot *snap;
+    LayerState next_layer[CHROMA_LAYERS];
+    unsigned char layer_dirty[CHROMA_LAYERS];
+    GLint target, target_viewport[4];
+
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &target);
+    glGetIntegerv(GL_VIEWPORT, target_viewport);
+    unsigned char resized = gl_layer_resize(target_viewport[2], target_viewport[3]);
+
+    // layers are drawn from the origin of their buffer
+    viewport[0] = 0;
+    viewport[1] = 0;
+    viewport[2] = target_viewport[2];
+    viewport[3] = target_viewport[3];
+
+    // projection is the same for every draw of the frame
+    gl_renderer_bind_projection();
+    gl_render_clear_dirty();
 
     clock_t start, end;
     start = clock();
 
+    graphics_snapshot_begin_read();
+
+    // advance the layer state, the pages are drawn from 
+    // their snapshots after releasing gl_lock
     g_mutex_lock(&gl_lock);
     for (int layer = 0; layer < CHROMA_LAYERS; layer++) {
+        LayerState *state = &next_layer[layer];
+        layer_page[layer] = NULL;
+
+        state->page_num = page_num[layer];
+        state->frame_num = frame_num[layer];
+        state->frame_time = frame_time[layer];
+        state->serial = 0;
+
         if (page_num[layer] < 0) {
+            state->action = action[layer];
             continue;
         }
 
         page = graphics_hub_get_page(&engine.hub, page_num[layer]);
         if (page == NULL) {
             log_file(LogWarn, "GL Render", "Missing page %s", page_num[layer]);
+            state->action = action[layer];
             continue;
         }
 
-        g_mutex_lock(&page->lock);
+        snap = graphics_page_snapshot(page);
+        if (snap == NULL) {
+            state->action = action[layer];
+            continue;
+        }
+
+        state->serial = snap->serial;
 
         switch (action[layer]) {
             case ANIMATE_OFF:
@@ -318,14 +635,14 @@ gboolean gl_render(GtkGLArea *area, GdkGLContext *context) {
             case CONTINUE:
                 current_page[layer] = page_num[layer];
                 bezier_time = gl_bezier_time_step(frame_time[layer], 0, 1, 3);
-                time = MIN(bezier_time + frame_num[layer], page->max_keyframe - 1);
+                time = MIN(bezier_time + frame_num[layer], snap->max_keyframe - 1);
 
                 if (frame_time[layer] < 0 || bezier_time < 0) {
                     log_file(LogError, "GL Renderer", "Time less than 0: page %d keyframe %d", 
                              page_num[layer], frame_num[layer] - 1);
                 }
 
-                graphics_page_interpolate_geometry(page, time * ANIM_LENGTH, ANIM_LENGTH);
+                layer_time[layer] = time;
                 frame_time[layer] = MIN(frame_time[layer] + 1.0f / ANIM_LENGTH, 1.0); 
                 break;
 
@@ -337,24 +654,62 @@ gboolean gl_render(GtkGLArea *area, GdkGLContext *context) {
                 log_file(LogError, "GL Render", "Unknown action %d", action);
         }
 
+        // ANIMATE_OFF may have blanked the layer
+        state->action = action[layer];
+
         if (action[layer] == BLANK) {
-            g_mutex_unlock(&page->lock);
             continue;
         }
 
         if (action[layer] == UPDATE) {
             log_file(LogWarn, "GL Renderer", "Action update not handled before renderer");
-            g_mutex_unlock(&page->lock);
             continue;
         }
 
-        gl_render_draw_heirachy(page, page->geometry[0], 0);
-        glClear(GL_STENCIL_BUFFER_BIT);
-        g_mutex_unlock(&page->lock);
+        layer_page[layer] = snap;
     }
     g_mutex_unlock(&gl_lock);
 
+    for (int layer = 0; layer < CHROMA_LAYERS; layer++) {
+        layer_dirty[layer] = resized || !drawn_valid 
+            || gl_render_layer_changed(&drawn_layer[layer], &next_layer[layer]);
+        drawn_layer[layer] = next_layer[layer];
+    }
+    drawn_valid = 1;
+
+    for (int layer = 0; layer < CHROMA_LAYERS; layer++) {
+        snap = layer_page[layer];
+        if (snap == NULL || !layer_dirty[layer]) {
+            continue;
+        }
+
+        gl_layer_begin(layer);
+
+        graphics_snapshot_interpolate(snap, layer_time[layer] * ANIM_LENGTH, ANIM_LENGTH);
+        gl_cache_page(&layer_cache[layer], snap->serial, snap->len_geometry);
+        gl_render_draw_page(snap, &layer_cache[layer]);
+
+        gl_render_clear_dirty();
+    }
+
+    graphics_snapshot_end_read();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glViewport(target_viewport[0], target_viewport[1], target_viewport[2], target_viewport[3]);
+
+    glClearColor(0, 0, 0, 0);
+    glClearStencil(0);
+    glStencilMask(0xFF);
+    glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    for (int layer = 0; layer < CHROMA_LAYERS; layer++) {
+        if (layer_page[layer] != NULL) {
+            gl_layer_composite(target, layer);
+        }
+    }
+
     g_mutex_lock(&engine.lock);
+    drawn_perf = engine.render_perf;
     if (engine.render_perf) {
         sprintf(render_text.buf, "%0.2f ms", render_time);
 
@@ -369,6 +724,4 @@ gboolean gl_render(GtkGLArea *area, GdkGLContext *context) {
     glFinish();
     end = clock();
     render_time = ((double) (end - start) * 1000) / CLOCKS_PER_SEC;
-
-    return TRUE;
 }
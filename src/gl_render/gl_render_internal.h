@@ -15,51 +15,98 @@
 #include "chroma-typedefs.h"
 #include "geometry.h"
 
-/* gl_renderer.c */
-#define TRIANGLE_CAP      (MEGABYTES((uint64_t)128) / sizeof( Triangle ))
+/* gl_triangle.c */
+#define QUAD_CAP          (MEGABYTES((uint64_t)32) / sizeof( Quad ))
+
+/* vertex ring buffer, in quads, vertices of a segment are indexed by a GLushort */
+#define RING_SEGMENTS     4
+#define RING_SEGMENT_CAP  16384
+
+// uniform buffer binding of the Projection block
+#define PROJECTION_BINDING 0
 
 typedef enum {
     RENDER_DRAW_NO_MASK = 0,
     RENDER_DRAW_MASK,
     RENDER_MASK,
-    RENDER_MASK_CLEAR,
 } RendererOptions;
 
 typedef enum {
     VERTEX_ATTR_POSITION = 0,
     VERTEX_ATTR_COLOR,
     VERTEX_ATTR_UV,
+    VERTEX_ATTR_SHAPE,
 } VertexAttr;
 
+/*
+ * Shapes shaded in the fragment shader, the 
+ * shape attribute of a vertex is 16 bit integers
+ *
+ *      SHAPE_NONE: {SHAPE_NONE, 0, 0, 0}, sample the atlas at uv
+ *      SHAPE_RECT: {SHAPE_RECT, width, height, rounding}
+ *      SHAPE_ARC:  {SHAPE_ARC, inner_radius / outer_radius, start_angle, span}
+ *
+ * The rect params are signed pixels. The arc params 
+ * are unsigned fractions, of SHAPE_UNIT for the ratio 
+ * and the span, and of a turn for the start angle, 
+ * decoded by the vertex shader. uv spans the quad 
+ * (the bounding square of the outer radius for an 
+ * arc) from {0, 0} to {1, 1}.
+ */
+typedef enum {
+    SHAPE_NONE = 0,
+    SHAPE_RECT,
+    SHAPE_ARC,
+} ShapeType;
+
+#define SHAPE_UNIT   UINT16_MAX
+
+/*
+ * Packed vertex, 24 bytes, color is normalized 
+ * RGBA8, uv is normalized 16 bit and shape is
+ * 16 bit integers.
+ */
 typedef struct {
-    vec2 pos;
-    vec4 color;
-    vec2 uv;
+    vec2     pos;
+    uint8_t  color[4];
+    uint16_t uv[2];
+    int16_t  shape[4];
 } Vertex;
 
+/* vertices in order around the quad, drawn as 0 1 2, 0 2 3 */
 typedef struct {
-    Vertex v[3];
-} Triangle;
+    Vertex v[4];
+} Quad;
 
 typedef struct Renderer {
     GLuint vao;
     GLuint vbo;
+    GLuint ebo;
     GLuint program;
+    GLuint atlas;
+
+    /* ring buffer state, see gl_triangle.c */
+    Quad *mapped;
+    size_t segment;
+    size_t head;
+    GLsync fence[RING_SEGMENTS];
 
     size_t count;
-    Triangle triangles[TRIANGLE_CAP];
+    Quad quads[QUAD_CAP];
 } Renderer;
 
 void gl_renderer_triangle_init(Renderer *r, const char *vert_file_path, const char *frag_file_path);
 void gl_renderer_use(Renderer *r);
-void gl_renderer_triangle(Renderer *r, vec2 p0, vec2 p1, vec2 p2, 
-                          vec4 c0, vec4 c1, vec4 c2, vec2 uv0, vec2 uv1, vec2 uv2);
+void gl_renderer_quad(Renderer *r, vec2 p0, vec2 p1, vec2 p2, vec2 p3, 
+                      vec4 color, vec2 uv0, vec2 uv1, vec2 uv2, vec2 uv3);
+void gl_renderer_triangle(Renderer *r, vec2 p0, vec2 p1, vec2 p2, vec4 color);
+void gl_renderer_shape(Renderer *r, vec2 pos, vec2 size, vec4 color, const int16_t shape[4]);
 void gl_renderer_mask(Renderer *r, RendererOptions opt, int depth);
 void gl_renderer_draw(Renderer *r);
 
 GLuint gl_renderer_create_shader(int type, const char *src);
 GLuint gl_renderer_create_program(GLuint vertex, GLuint fragment);
-void gl_renderer_set_scale(GLuint program);
+void gl_renderer_bind_projection(void);
 
 extern const char *glimage_vs_glsl;
 extern const char *glimage_fs_glsl;
@@ -67,8 +114,51 @@ extern const char *glrender_vs_glsl;
 extern const char *glrender_fs_glsl;
 extern const char *glshape_vs_glsl;
 extern const char *glshape_fs_glsl;
-extern const char *gltext_vs_glsl;
-extern const char *gltext_fs_glsl;
+extern const char *glcomposite_vs_glsl;
+extern const char *glcomposite_fs_glsl;
+
+/* gl_cache.c */
+
+/*
+ * Draw of a page compiled from the geometry hierarchy,
+ * a list of stencil states, geometry to draw in the 
+ * current state, and clears of a stencil bit.
+ */
+typedef enum {
+    RENDER_OP_STATE,
+    RENDER_OP_DRAW,
+    RENDER_OP_CLEAR,
+} RenderOpType;
+
+typedef struct {
+    RenderOpType    type;
+    RendererOptions opt;
+    int             depth;
+    int             geo_num;
+} RenderOp;
+
+typedef struct {
+    unsigned char valid;
+    unsigned int  version;
+    size_t        count;
+    size_t        capacity;
+    Quad          *quads;
+} GeometryCache;
+
+typedef struct {
+    unsigned char valid;
+    unsigned int  serial;
+    size_t        len_geometry;
+    GeometryCache *geometry;
+
+    size_t        num_ops;
+    size_t        ops_capacity;
+    RenderOp      *ops;
+} PageCache;
+
+void gl_cache_page(PageCache *cache, unsigned int serial, size_t len_geometry);
+unsigned char gl_cache_draw(Renderer *r, PageCache *cache, IGeometry *geo);
+void gl_cache_store(Renderer *r, PageCache *cache, IGeometry *geo, size_t start);
 
 /* gl_rect.c */
 void gl_draw_rectangle(Renderer *r, GeometryRect *rect);
@@ -87,16 +177,20 @@ void gl_graph_init_shaders(void);
 void gl_draw_graph(IGeometry *graph);
 
 /* gl_text.c */
-void gl_text_init_buffers(void);
-void gl_text_init_shaders(void);
-void gl_text_cache_characters(void);
-void gl_draw_text(IGeometry *text);
+void gl_text_cache_characters(Renderer *r);
+void gl_draw_text(Renderer *r, GeometryText *text);
 
 /* gl_image.c */
 void gl_image_init_buffers(void);
 void gl_image_init_shaders(void);
 void gl_draw_image(IGeometry *image);
 
+/* gl_layer.c */
+void gl_layer_init(void);
+unsigned char gl_layer_resize(int width, int height);
+void gl_layer_begin(int layer);
+void gl_layer_composite(GLuint target, int layer);
+
 /* gl_poly.c */
 void gl_polygon_init_buffers(void);
 void gl_polygon_init_shaders(void);
@@ -3,6 +3,10 @@
  *
  * Shaders for GL Renderer
  *
+ * The projection matrices are shared by every
+ * program through the Projection uniform block,
+ * see gl_renderer_create_program.
+ *
  */
 
 #include "gl_render_internal.h"
@@ -12,9 +16,11 @@ const char *glimage_vs_glsl = "#version 330 core\n"
 "layout (location = 1) in vec3 aColor;"
 "layout (location = 2) in vec2 aTexCoord;"
 
-"uniform mat4 model;"
-"uniform mat4 view;"
-"uniform mat4 ortho;"
+"layout (std140, row_major) uniform Projection {"
+    "mat4 model;"
+    "mat4 view;"
+    "mat4 ortho;"
+"};"
 
 "out vec3 outColor;"
 "out vec2 TexCoord;"
@@ -46,38 +52,110 @@ const char *glrender_vs_glsl = "#version 330 core\n"
 "layout(location = 0) in vec2 position;"
 "layout(location = 1) in vec4 color;"
 "layout(location = 2) in vec2 uv;"
+"layout(location = 3) in ivec4 shape;"
 
 "out vec4 out_color;"
 "out vec2 out_uv;"
+"flat out vec4 out_shape;"
+
+"const float PI = 3.14159265;"
 
-"uniform mat4 model;"
-"uniform mat4 view;"
-"uniform mat4 ortho;"
+"layout (std140, row_major) uniform Projection {"
+    "mat4 model;"
+    "mat4 view;"
+    "mat4 ortho;"
+"};"
 
 "void main(){"
     "out_color = color;"
     "out_uv = uv;"
+    "out_shape = vec4(shape);"
+
+    // arc params are unsigned fractions, see ShapeType
+    "if (shape.x == 2) {"
+        "vec3 arc = vec3(shape.yzw & 0xffff);"
+        "out_shape.y = arc.x / 65535.0;"
+        "out_shape.z = arc.y / 65536.0 * 2.0 * PI;"
+        "out_shape.w = arc.z / 65535.0 * 2.0 * PI;"
+    "}"
 
     "gl_Position = ortho * view * model * vec4(position, 0.0, 1.0);"
 "};";
 
+/*
+ * Shapes are shaded by the signed distance d to the 
+ * edge of the shape (negative inside), with coverage 
+ * 0.5 - d / fwidth(d) for anti-aliasing. Fragments 
+ * outside the shape are discarded so they are not 
+ * written to the stencil buffer in a mask pass.
+ */
 const char *glrender_fs_glsl = "#version 330 core\n"
+"#define PI 3.14159265\n"
 "in vec4 out_color;\n"
 "in vec2 out_uv;\n"
+"flat in vec4 out_shape;\n"
+"out vec4 frag_color;\n"
+
+"uniform sampler2D atlas;\n"
+
+"float rect_dist(vec2 uv, vec3 rect) {\n"
+    "vec2 half_size = abs(rect.xy) / 2.0;\n"
+    "vec2 p = abs((uv - 0.5) * rect.xy);\n"
+    "vec2 q = p - half_size + rect.z;\n"
+    "return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - rect.z;\n"
+"}\n"
+
+"float arc_dist(vec2 uv, vec3 arc) {\n"
+    "vec2 p = 2.0 * uv - 1.0;\n"
+    "float len = length(p);\n"
+    "float d = max(len - 1.0, arc.x - len);\n"
+    "float span = arc.z;\n"
+
+    "if (span >= 2.0 * PI) {\n"
+        "return d;\n"
+    "}\n"
+
+    "float a = mod(atan(p.y, p.x) - arc.y, 2.0 * PI);\n"
+    "float edge;\n"
+
+    "if (a <= span) {\n"
+        "edge = -len * sin(min(min(a, span - a), PI / 2.0));\n"
+    "} else {\n"
+        "edge = len * sin(min(min(a - span, 2.0 * PI - a), PI / 2.0));\n"
+    "}\n"
+
+    "return max(d, edge);\n"
+"}\n"
 
 "void main() {\n"
-    "gl_FragColor = out_color;\n"
+    "float alpha;\n"
+
+    "if (out_shape.x == 0.0) {\n"
+        "alpha = texture(atlas, out_uv).r;\n"
+    "} else {\n"
+        "float d = (out_shape.x == 1.0) ? rect_dist(out_uv, out_shape.yzw) : arc_dist(out_uv, out_shape.yzw);\n"
+        "alpha = clamp(0.5 - d / max(fwidth(d), 1e-6), 0.0, 1.0);\n"
+
+        "if (alpha <= 0.0) {\n"
+            "discard;\n"
+        "}\n"
+    "}\n"
+
+    "frag_color = out_color * vec4(1.0, 1.0, 1.0, alpha);\n"
 "}";
 
 const char *glshape_vs_glsl = "#version 330 core\n"
-"layout (location = 0) in vec3 vertex;"
+"layout (location = 0) in vec2 vertex;"
+"uniform vec2 translate;"
 
-"uniform mat4 model;"
-"uniform mat4 view;"
-"uniform mat4 ortho;"
+"layout (std140, row_major) uniform Projection {"
+    "mat4 model;"
+    "mat4 view;"
+    "mat4 ortho;"
+"};"
 
 "void main(){"
-    "gl_Position = ortho * view * model * vec4(vertex, 1.0);"
+    "gl_Position = ortho * view * model * vec4(vertex + translate, 0.0, 1.0);"
 "};";
 
 const char *glshape_fs_glsl = "#version 330 core\n"
@@ -88,33 +166,22 @@ const char *glshape_fs_glsl = "#version 330 core\n"
     "FragColor = color;"
 "};";
 
-const char *gltext_vs_glsl = "#version 330 core\n"
-"layout (location = 0) in vec4 vertex; // <vec2 pos, vec2 tex>\n"
-"out vec2 TexCoords;"
-
-"uniform mat4 model;"
-"uniform mat4 view;"
-"uniform mat4 ortho;"
+const char *glcomposite_vs_glsl = "#version 330 core\n"
+"out vec2 uv;"
 
 "void main(){"
-    "vec4 rectPos = vec4(vertex.xy, 0.0, 1.0);"
+    // full screen triangle from the vertex id
+    "vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);"
+    "uv = pos;"
 
-    "mat4 M = ortho * view * model;"
-
-    "gl_Position = M * rectPos;"
-
-    "TexCoords = vertex.zw;"
+    "gl_Position = vec4(2.0 * pos - 1.0, 0.0, 1.0);"
 "};";
 
-const char *gltext_fs_glsl = "#version 330 core\n"
-"in vec2 TexCoords;"
+const char *glcomposite_fs_glsl = "#version 330 core\n"
+"in vec2 uv;"
+"uniform sampler2D layer;"
 "out vec4 FragColor;"
 
-"uniform sampler2D text;"
-"uniform vec4 color;"
-
 "void main(){"
-    "vec4 sampled = vec4(1.0, 1.0, 1.0, texture2D(text, TexCoords).r);"
-    "FragColor = color * sampled;"
-
+    "FragColor = texture(layer, uv);"
 "};";
@@ -10,46 +10,29 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
-static GLuint vao;
-static GLuint vbo;
-static GLuint program;
+/*
+ * Glyphs are packed into rows of a single atlas 
+ * texture, so text is drawn as textured quads by 
+ * the triangle renderer. The atlas has a block of
+ * white texels at the origin, which untextured 
+ * shapes sample with uv (0, 0).
+ */
+
+#define ATLAS_SIZE          1024
+#define ATLAS_WHITE_SIZE    4
+#define ATLAS_PADDING       1
 
 struct Character {
-    unsigned int TextureID;
     GLfloat      Size[2];
     GLfloat      Bearing[2];
     unsigned int Advance;
+    GLfloat      UV0[2];
+    GLfloat      UV1[2];
 };
 
 static struct Character Characters[128];
 
-void gl_text_init_buffers(void) {
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-
-    glBindVertexArray(vao);
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof( float ) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
-
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof( float ), 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
-} 
-
-void gl_text_init_shaders(void) {
-    GLuint vertex = gl_renderer_create_shader(GL_VERTEX_SHADER, gltext_vs_glsl);
-    GLuint fragment = gl_renderer_create_shader(GL_FRAGMENT_SHADER, gltext_fs_glsl);
-
-    program = gl_renderer_create_program(vertex, fragment);
-
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
-}
-
-void gl_text_cache_characters(void) {
+void gl_text_cache_characters(Renderer *r) {
     // init characters
     FT_Library ft;
     if (FT_Init_FreeType(&ft)) {
@@ -66,41 +49,70 @@ void gl_text_cache_characters(void) {
     // disable byte-alignment restriction
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
+    glGenTextures(1, &r->atlas);
+    glBindTexture(GL_TEXTURE_2D, r->atlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, ATLAS_SIZE, ATLAS_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+
+    // set texture options 
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    {
+        // clear atlas, with white at the origin
+        unsigned char *pixels = NEW_ARRAY(ATLAS_SIZE * ATLAS_SIZE, unsigned char);
+        memset(pixels, 0, ATLAS_SIZE * ATLAS_SIZE);
+
+        for (int y = 0; y < ATLAS_WHITE_SIZE; y++) {
+            memset(&pixels[y * ATLAS_SIZE], 0xFF, ATLAS_WHITE_SIZE);
+        }
+
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, ATLAS_SIZE, ATLAS_SIZE, GL_RED, GL_UNSIGNED_BYTE, pixels);
+        free(pixels);
+    }
+
+    int x = ATLAS_WHITE_SIZE + ATLAS_PADDING;
+    int y = 0;
+    int row_height = ATLAS_WHITE_SIZE;
+
     for (unsigned char c = 0; c < 128; c++) {
         // load character glyph
         if (FT_Load_Char(face, c, FT_LOAD_RENDER)) {
             log_file(LogWarn, "Geometry", "Failed to load Glyph %c", c);
         }
 
-        // generate texture 
-        unsigned int texture;
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            GL_RED,
-            face->glyph->bitmap.width,
-            face->glyph->bitmap.rows,
-            0,
-            GL_RED,
-            GL_UNSIGNED_BYTE,
-            face->glyph->bitmap.buffer
-        );
-
-        // set texture options 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        int w = face->glyph->bitmap.width;
+        int h = face->glyph->bitmap.rows;
+
+        if (x + w > ATLAS_SIZE) {
+            // next row
+            x = 0;
+            y += row_height + ATLAS_PADDING;
+            row_height = 0;
+        }
+
+        if (y + h > ATLAS_SIZE) {
+            log_file(LogWarn, "Geometry", "Glyph atlas is full, skipping glyph %d", c);
+            w = 0;
+            h = 0;
+        }
+
+        if (w > 0 && h > 0) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RED, GL_UNSIGNED_BYTE, face->glyph->bitmap.buffer);
+        }
 
         // store character 
         Characters[c] = (struct Character){
-            texture,
             {face->glyph->bitmap.width, face->glyph->bitmap.rows},
             {face->glyph->bitmap_left, face->glyph->bitmap_top},
-            face->glyph->advance.x
+            face->glyph->advance.x,
+            {(float) x / ATLAS_SIZE, (float) y / ATLAS_SIZE},
+            {(float) (x + w) / ATLAS_SIZE, (float) (y + h) / ATLAS_SIZE},
         };
+
+        x += w + ATLAS_PADDING;
+        row_height = MAX(row_height, h);
     }
     glBindTexture(GL_TEXTURE_2D, 0);
 
@@ -108,30 +120,14 @@ void gl_text_cache_characters(void) {
     FT_Done_FreeType(ft);
 }
 
-void gl_draw_text(IGeometry *text) {
-    int text_x = geometry_get_int_attr(text, GEO_POS_X); 
-    int text_y = geometry_get_int_attr(text, GEO_POS_Y); 
-    float scale = geometry_get_float_attr(text, GEO_SCALE);
+void gl_draw_text(Renderer *r, GeometryText *text) {
+    int text_x = text->geo.pos.x;
+    int text_y = text->geo.pos.y;
+    float scale = text->scale;
+    vec4 color = text->color;
 
-    char buf[100];
-    memset(buf, '\0', sizeof buf);
-    geometry_get_attr(text, "string", buf);
-
-    // Copy vertices array in a buffer for OpenGL
-    gl_renderer_set_scale(program);
-    glUseProgram(program);
-
-    GeometryText *g_text = (GeometryText *)text;
-    GLint color_loc = glGetUniformLocation(program, "color");
-    glUniform4f(color_loc, g_text->color.x, g_text->color.y, 
-                g_text->color.z, g_text->color.w); 
-    glBindVertexArray(vao);
-
-    glEnable(GL_CULL_FACE);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    for (int i = 0; buf[i] != '\0'; i++) {
-        struct Character ch = Characters[(unsigned char)buf[i]];
+    for (int i = 0; i < GEO_BUF_SIZE && text->buf[i] != '\0'; i++) {
+        struct Character ch = Characters[(unsigned char)text->buf[i] & 0x7F];
 
         float xpos = text_x + ch.Bearing[0] * scale;
         float ypos = text_y - (ch.Size[1] - ch.Bearing[1]) * scale;
@@ -139,37 +135,22 @@ void gl_draw_text(IGeometry *text) {
         float w = ch.Size[0] * scale;
         float h = ch.Size[1] * scale;
 
-        // update vbo
-        float vertices[6][4] = {
-            { xpos,     ypos + h, 0.0f, 0.0f },
-            { xpos,     ypos,     0.0f, 1.0f },
-            { xpos + w, ypos,     1.0f, 1.0f },
+        // bitmap rows start at the top of the glyph
+        vec2 p0 = {xpos,     ypos + h};
+        vec2 p1 = {xpos,     ypos};
+        vec2 p2 = {xpos + w, ypos};
+        vec2 p3 = {xpos + w, ypos + h};
 
-            { xpos,     ypos + h, 0.0f, 0.0f },
-            { xpos + w, ypos,     1.0f, 1.0f },
-            { xpos + w, ypos + h, 1.0f, 0.0f },
-        };
+        vec2 uv0 = {ch.UV0[0], ch.UV0[1]};
+        vec2 uv1 = {ch.UV0[0], ch.UV1[1]};
+        vec2 uv2 = {ch.UV1[0], ch.UV1[1]};
+        vec2 uv3 = {ch.UV1[0], ch.UV0[1]};
 
-        // render glyph texture over quad
-        glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-
-        // update content of vbo memory
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof vertices, vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        // render quad
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        gl_renderer_quad(r, p0, p1, p2, p3, color, uv0, uv1, uv2, uv3);
 
         // advance cursors for next glyph
         text_x += (ch.Advance >> 6) * scale;
     }
-
-    glDisable(GL_CULL_FACE);
-    
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glUseProgram(0);
 }
 
 unsigned int gl_text_text_width(char *text, float scale) {
@@ -1,5 +1,24 @@
 /*
  * gl_triangle.c
+ *
+ * Batched quad renderer. Quads are collected in
+ * r->quads and streamed into a vertex buffer by
+ * gl_renderer_draw. Triangles are stored as quads with
+ * the last vertex repeated. Every quad is drawn with
+ * the same 6 indices, so the index buffer is built
+ * once for a segment and drawn with a base vertex.
+ *
+ * The vertex buffer is a ring of RING_SEGMENTS segments.
+ * Each draw is written after the previous draw in the
+ * current segment. When a segment is full, a fence is
+ * placed behind it and the next segment is used, waiting
+ * on its fence if the GPU has not finished the draws
+ * from the last time around. Consecutive draws in a
+ * frame never write over a buffer range in use.
+ *
+ * The buffer is persistently mapped if immutable buffer
+ * storage is supported, otherwise each range is mapped
+ * unsynchronized, which is safe behind the fences.
  */
 
 #include "gl_render_internal.h"
@@ -9,9 +28,23 @@ void gl_renderer_triangle_init(Renderer *r, const char *vs, const char *fs) {
         glGenVertexArrays(1, &r->vao);
         glBindVertexArray(r->vao);
 
+        GLsizeiptr size = RING_SEGMENTS * RING_SEGMENT_CAP * sizeof( Quad );
         glGenBuffers(1, &r->vbo);
         glBindBuffer(GL_ARRAY_BUFFER, r->vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof( r->triangles ), r->triangles, GL_DYNAMIC_DRAW);
+
+        if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+            glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+            r->mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+            r->mapped = NULL;
+        }
+
+        r->segment = 0;
+        r->head = 0;
+        memset(r->fence, 0, sizeof r->fence);
 
         // position
         glEnableVertexAttribArray(0);
@@ -20,13 +53,36 @@ void gl_renderer_triangle_init(Renderer *r, const char *vs, const char *fs) {
 
         // color 
         glEnableVertexAttribArray(1);
-        glVertexAttribPointer(VERTEX_ATTR_COLOR, 4, GL_FLOAT, GL_FALSE, sizeof( Vertex ), 
+        glVertexAttribPointer(VERTEX_ATTR_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof( Vertex ), 
                               (GLvoid *)offsetof(Vertex, color));
 
         // texture
         glEnableVertexAttribArray(2);
-        glVertexAttribPointer(VERTEX_ATTR_UV, 2, GL_FLOAT, GL_FALSE, sizeof( Vertex ), 
+        glVertexAttribPointer(VERTEX_ATTR_UV, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof( Vertex ), 
                               (GLvoid *)offsetof(Vertex, uv));
+
+        // shape 
+        glEnableVertexAttribArray(3);
+        glVertexAttribIPointer(VERTEX_ATTR_SHAPE, 4, GL_SHORT, sizeof( Vertex ), 
+                               (GLvoid *)offsetof(Vertex, shape));
+
+        // quad indices, bound to the vao
+        GLushort *indices = NEW_ARRAY(6 * RING_SEGMENT_CAP, GLushort);
+        for (GLushort i = 0; i < RING_SEGMENT_CAP; i++) {
+            GLushort v = 4 * i;
+
+            indices[6 * i + 0] = v + 0;
+            indices[6 * i + 1] = v + 1;
+            indices[6 * i + 2] = v + 2;
+            indices[6 * i + 3] = v + 0;
+            indices[6 * i + 4] = v + 2;
+            indices[6 * i + 5] = v + 3;
+        }
+
+        glGenBuffers(1, &r->ebo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * RING_SEGMENT_CAP * sizeof( GLushort ), indices, GL_STATIC_DRAW);
+        free(indices);
     }
 
     GLuint vertex = gl_renderer_create_shader(GL_VERTEX_SHADER, vs);
@@ -36,6 +92,10 @@ void gl_renderer_triangle_init(Renderer *r, const char *vs, const char *fs) {
 
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+
+    // glyph atlas is bound to texture unit 0
+    glUseProgram(r->program);
+    glUniform1i(glGetUniformLocation(r->program, "atlas"), 0);
 }
 
 void gl_renderer_use(Renderer *r) {
@@ -43,26 +103,58 @@ void gl_renderer_use(Renderer *r) {
     glBindVertexArray(r->vao);
     glBindBuffer(GL_ARRAY_BUFFER, r->vbo);
 
-    gl_renderer_set_scale(r->program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, r->atlas);
 }
 
-void gl_renderer_triangle(Renderer *r, vec2 p0, vec2 p1, vec2 p2, 
-                          vec4 c0, vec4 c1, vec4 c2, vec2 uv0, vec2 uv1, vec2 uv2) {
+static void gl_renderer_vertex(Vertex *v, vec2 pos, vec4 color, vec2 uv, const int16_t shape[4]) {
+    v->pos = pos;
+    memcpy(v->shape, shape, sizeof v->shape);
 
-    log_assert(r->count < TRIANGLE_CAP, "GL Renderer", "Too many triangles");
-    Triangle *tri = &r->triangles[r->count++];
+    v->color[0] = CLAMP(color.x, 0.0f, 1.0f) * 255.0f + 0.5f;
+    v->color[1] = CLAMP(color.y, 0.0f, 1.0f) * 255.0f + 0.5f;
+    v->color[2] = CLAMP(color.z, 0.0f, 1.0f) * 255.0f + 0.5f;
+    v->color[3] = CLAMP(color.w, 0.0f, 1.0f) * 255.0f + 0.5f;
 
-    tri->v[0].pos = p0;
-    tri->v[1].pos = p1;
-    tri->v[2].pos = p2;
+    v->uv[0] = CLAMP(uv.x, 0.0f, 1.0f) * 65535.0f + 0.5f;
+    v->uv[1] = CLAMP(uv.y, 0.0f, 1.0f) * 65535.0f + 0.5f;
+}
 
-    tri->v[0].color = c0;
-    tri->v[1].color = c1;
-    tri->v[2].color = c2;
+/*
+ * Add a quad with vertices p0, p1, p2, p3 in order 
+ * around the quad.
+ */
+void gl_renderer_quad(Renderer *r, vec2 p0, vec2 p1, vec2 p2, vec2 p3, 
+                      vec4 color, vec2 uv0, vec2 uv1, vec2 uv2, vec2 uv3) {
 
-    tri->v[0].uv = uv0;
-    tri->v[1].uv = uv1;
-    tri->v[2].uv = uv2;
+    log_assert(r->count < QUAD_CAP, "GL Renderer", "Too many quads");
+    Quad *quad = &r->quads[r->count++];
+    int16_t shape[4] = {SHAPE_NONE, 0, 0, 0};
+
+    gl_renderer_vertex(&quad->v[0], p0, color, uv0, shape);
+    gl_renderer_vertex(&quad->v[1], p1, color, uv1, shape);
+    gl_renderer_vertex(&quad->v[2], p2, color, uv2, shape);
+    gl_renderer_vertex(&quad->v[3], p3, color, uv3, shape);
+}
+
+void gl_renderer_triangle(Renderer *r, vec2 p0, vec2 p1, vec2 p2, vec4 color) {
+    vec2 u0 = {0, 0};
+
+    gl_renderer_quad(r, p0, p1, p2, p2, color, u0, u0, u0, u0);
+}
+
+/*
+ * Add an axis aligned quad at pos with the given size,
+ * shaded as the shape in the fragment shader.
+ */
+void gl_renderer_shape(Renderer *r, vec2 pos, vec2 size, vec4 color, const int16_t shape[4]) {
+    log_assert(r->count < QUAD_CAP, "GL Renderer", "Too many quads");
+    Quad *quad = &r->quads[r->count++];
+
+    gl_renderer_vertex(&quad->v[0], pos, color, (vec2){0, 0}, shape);
+    gl_renderer_vertex(&quad->v[1], (vec2){pos.x + size.x, pos.y}, color, (vec2){1, 0}, shape);
+    gl_renderer_vertex(&quad->v[2], ADD2(pos, size), color, (vec2){1, 1}, shape);
+    gl_renderer_vertex(&quad->v[3], (vec2){pos.x, pos.y + size.y}, color, (vec2){0, 1}, shape);
 }
 
 void gl_renderer_mask(Renderer *r, RendererOptions opt, int depth) {
@@ -86,18 +178,74 @@ void gl_renderer_mask(Renderer *r, RendererOptions opt, int depth) {
             glStencilMask(1 << depth);
             glStencilFunc(GL_NEVER, 1 << depth, 0xFF);
             break;
+    }
+}
 
-        case RENDER_MASK_CLEAR:
-            glDisable(GL_BLEND);
-            glStencilMask(1 << depth);
-            glStencilFunc(GL_NEVER, 0, 0xFF);
-            break;
+/*
+ * Fence the current segment and move to the next,
+ * waiting for the GPU to finish reading it.
+ */
+static void gl_renderer_next_segment(Renderer *r) {
+    r->fence[r->segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    r->segment = (r->segment + 1) % RING_SEGMENTS;
+    r->head = r->segment * RING_SEGMENT_CAP;
+
+    GLsync fence = r->fence[r->segment];
+    if (fence == NULL) {
+        return;
     }
+
+    GLenum res = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    if (res == GL_TIMEOUT_EXPIRED || res == GL_WAIT_FAILED) {
+        log_file(LogWarn, "GL Renderer", "Waiting on vertex buffer segment %lu failed", r->segment);
+    }
+
+    glDeleteSync(fence);
+    r->fence[r->segment] = NULL;
+}
+
+/*
+ * Reserve space for up to n quads at r->head,
+ * returns the number of quads reserved.
+ */
+static size_t gl_renderer_reserve(Renderer *r, size_t n) {
+    size_t start = r->segment * RING_SEGMENT_CAP;
+    size_t end = start + RING_SEGMENT_CAP;
+
+    // start a new segment rather than split a draw
+    if (r->head + n > end && r->head > start) {
+        gl_renderer_next_segment(r);
+        end = r->head + RING_SEGMENT_CAP;
+    }
+
+    return MIN(n, end - r->head);
 }
 
 void gl_renderer_draw(Renderer *r) {
-    glBufferSubData(GL_ARRAY_BUFFER, 0, r->count * sizeof( Triangle ), r->triangles);
-    glDrawArrays(GL_TRIANGLES, 0, r->count * 3);
+    size_t i = 0;
+
+    glBindBuffer(GL_ARRAY_BUFFER, r->vbo);
+
+    while (i < r->count) {
+        size_t n = gl_renderer_reserve(r, r->count - i);
+
+        if (r->mapped != NULL) {
+            memcpy(&r->mapped[r->head], &r->quads[i], n * sizeof( Quad ));
+        } else {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+            void *dst = glMapBufferRange(GL_ARRAY_BUFFER, r->head * sizeof( Quad ), 
+                                         n * sizeof( Quad ), flags);
+
+            memcpy(dst, &r->quads[i], n * sizeof( Quad ));
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+
+        glDrawElementsBaseVertex(GL_TRIANGLES, n * 6, GL_UNSIGNED_SHORT, 0, r->head * 4);
+
+        r->head += n;
+        i += n;
+    }
+
     r->count = 0;
 }
 
@@ -11,7 +11,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
-#define MAX_PAGE_SIZE     GIGABYTES((uint64_t) 8)
+#define PAGE_BLOCK_SIZE   MEGABYTES((uint64_t) 1)
+#define HUB_BLOCK_SIZE    MEGABYTES((uint64_t) 16)
 #define MAX_ASSETS        1024
 
 typedef enum {
@@ -41,46 +42,147 @@ typedef enum {
     EVAL_SUM_VALUE,
 } NodeEval;
 
-typedef struct Edge {
-    unsigned char pad;
+#define GRAPH_NO_NODE       SIZE_MAX
+#define GRAPH_NO_SLOT       UINT32_MAX
+
+/*
+ * Edge from node to the node of attr at index, edges
+ * are stored in the order they are added.
+ */
+typedef struct {
+    size_t        node;
     size_t        index;
     GeometryAttr  attr;
-
-    struct Edge   *next;
-    struct Edge   *prev;
+    unsigned char pad;
 } Edge;
 
-typedef struct Node {
+typedef struct {
     GeometryAttr  attr;
     float         value;
     NodeEval      eval;
     unsigned char evaluated;
     unsigned char visited;
     unsigned char discovered;
-
-    Edge          edge_list_head;
-    Edge          edge_list_tail;
-
-    struct Node   *next;
-    struct Node   *prev;
+    unsigned char dirty;
 } Node;
 
 typedef struct {
-    Arena         *arena;
     size_t        node_count;
     size_t        num_nodes;
+    size_t        nodes_capacity;
     size_t        num_edges;
-
-    Node          *node_list_head;
-    Node          *node_list_tail;
+    size_t        edges_capacity;
+
+    /* nodes and edges, a node id is the index in node */
+    Node          *node;
+    Edge          *edge;
+
+    /* 
+     * Id of the node of attr at index is 
+     * slot[index * GEO_NUMBER + attr], or GRAPH_NO_SLOT.
+     */
+    uint32_t      *slot;
+
+    /* 
+     * Compiled graph, built by graphics_graph_compile. 
+     * Edges of node id are edge_node[edge_offset[id]] 
+     * to edge_node[edge_offset[id + 1] - 1], and order 
+     * lists the non leaf nodes in evaluation order.
+     *
+     * The dependents of node id (reversed edges) are 
+     * stored the same way in dep_offset and dep_node.
+     */
+    unsigned char compiled;
+    size_t        *edge_offset;
+    size_t        *edge_node;
+    unsigned char *edge_pad;
+    size_t        *dep_offset;
+    size_t        *dep_node;
+    size_t        num_order;
+    size_t        *order;
+    size_t        *order_index;
+
+    /* nodes updated since the last evaluation */
+    unsigned char evaluate_all;
+    size_t        num_dirty;
+    size_t        *dirty;
+    size_t        *stack;
 } Graph;
 
+/*
+ * Image assets received from the hub, version is
+ * incremented each time the image data is replaced
+ * or invalidated, so the renderer can tell when to 
+ * upload it again. The asset is requested again 
+ * when loaded, the version of data, is behind.
+ *
+ * data is replaced holding the img_lock of the hub,
+ * which the renderer holds while uploading data.
+ */
 typedef struct {
     int             w;
     int             h;
+    int             version;
+    int             loaded;
     unsigned char   *data;
 } Image;
 
+/*
+ * Keyframe values of a page baked for interpolation,
+ * see gr_track.c. Tracks of keyframe segment s (from
+ * keyframe s to s + 1) with field type f are the tracks
+ * offset[s * GEO_FIELD_NUMBER + f] to 
+ * offset[s * GEO_FIELD_NUMBER + f + 1] - 1. Writing a
+ * changed value to a field increments the version of 
+ * the geometry.
+ */
+typedef struct {
+    unsigned char   baked;
+    size_t          num_segments;
+    size_t          num_tracks;
+    size_t          capacity;
+    size_t          *offset;
+
+    float           *start;
+    float           *delta;
+    float           *value;
+    void            **field;
+    unsigned int    **version;
+    size_t          *node;
+    size_t          *next_node;
+    int             *geo_id;
+} Tracks;
+
+/*
+ * Copy of the geometry and tracks of a page, built 
+ * by the parser with graphics_page_publish and read 
+ * by the renderer without taking the page lock, 
+ * see gr_snapshot.c.
+ *
+ * The children of geometry i are child[child_offset[i]]
+ * to child[child_offset[i + 1] - 1] in order of geo id, 
+ * draw has the same children with the unmasked children
+ * first, and the masked children from mask_offset[i].
+ */
+typedef struct PageSnapshot {
+    unsigned int        temp_id;
+    unsigned int        len_geometry;
+    unsigned int        max_keyframe;
+    IGeometry           **geometry;
+    Tracks              tracks;
+
+    size_t              *child_offset;
+    size_t              *mask_offset;
+    int                 *child;
+    int                 *draw;
+    unsigned char       keyframed_hierarchy;
+
+    int8_t              *memory;
+    unsigned int        serial;
+    unsigned int        retire_epoch;
+    struct PageSnapshot *next;
+} PageSnapshot;
+
 typedef struct {
     GMutex          lock;
     unsigned int    temp_id;
@@ -90,6 +192,14 @@ typedef struct {
 
     unsigned int    max_keyframe;
     Graph           keyframe_graph;
+    Tracks          tracks;
+
+    PageSnapshot    *snapshot;
+    PageSnapshot    *retired;
+
+    // set when the keyframe graph has been updated since
+    // the page was last published, see graphics_hub_flush_pages
+    gint            pending;
 } IPage;
 
 extern IGeometry    *graphics_page_add_geometry(IPage *page, int type, int geo_id);
@@ -101,6 +211,7 @@ typedef struct {
     IPage           **items;
 
     Arena           arena;
+    GMutex          img_lock;
     Image           img[MAX_ASSETS];
 } IGraphics;
 
@@ -111,6 +222,7 @@ extern void         graphics_free_graphics_hub(IGraphics *hub);
 
 extern IPage        *graphics_hub_get_page(IGraphics *hub, int temp_id);
 extern IPage        *graphics_hub_new_page(IGraphics *hub, int num_geo, int max_keyframe, int temp_id);
+extern void         graphics_hub_flush_pages(IGraphics *hub);
 
 extern uint64_t     graphics_graph_size(Graph *g);
 extern unsigned char graphics_graph_is_dag(Graph *g);
@@ -122,6 +234,14 @@ extern void         graphics_page_gen_frame(IPage *page, Keyframe frame);
 extern void         graphics_graph_update_leaf(Graph *g, size_t x, GeometryAttr attr, float value);
 extern void         graphics_page_default_relations(IPage *page);
 extern void         graphics_page_calculate_keyframes(IPage *page);
+extern void         graphics_page_mark_pending(IPage *page);
 extern void         graphics_page_interpolate_geometry(IPage *page, int index, int width);
 
+/* gr_snapshot.c */
+extern void         graphics_page_publish(IPage *page);
+extern PageSnapshot *graphics_page_snapshot(IPage *page);
+extern void         graphics_snapshot_interpolate(PageSnapshot *snap, int index, int width);
+extern void         graphics_snapshot_begin_read(void);
+extern void         graphics_snapshot_end_read(void);
+
 #endif // !CHROMA_PAGE
@@ -1,100 +1,205 @@
 /*
  * gr_graph.c
+ *
+ * Keyframe graph of a page. A node holds the value
+ * of an attr of a geometry in a keyframe, and the
+ * edges of a node are the nodes its value is
+ * evaluated from.
+ *
+ * Nodes and edges are stored in flat arrays in the 
+ * order they are added, nodes are referred to by 
+ * their index in the node array. The id of the node
+ * of an attr at a keyframe index is kept in a dense
+ * uint32_t slot table, so a lookup is one array access.
+ *
  */
 
 #include "graphics_internal.h"
 #include <limits.h>
+#include <stdint.h>
 
-void graphics_new_graph(Arena *a, Graph *g, size_t n) {
-    g->arena = a;
+void graphics_new_graph(Graph *g, size_t n) {
+    memset(g, 0, sizeof( Graph ));
     g->node_count = n;
-    g->num_edges = 0;
-    g->num_nodes = 0;
+    g->evaluate_all = 1;
 
-    g->node_list_head = ARENA_ARRAY(g->arena, g->node_count, Node);
-    g->node_list_tail = ARENA_ARRAY(g->arena, g->node_count, Node);
+    g->slot = NEW_ARRAY(g->node_count * GEO_NUMBER, uint32_t);
+    log_assert(g->node_count == 0 || g->slot != NULL, "Graph", "Unable to allocate graph slots");
 
-    for (size_t i = 0; i < g->node_count; i++) {
-        g->node_list_head[i].next = &g->node_list_tail[i];
-        g->node_list_head[i].prev = NULL;
-        g->node_list_tail[i].next = NULL;
-        g->node_list_tail[i].prev = &g->node_list_head[i];
+    for (size_t i = 0; i < g->node_count * GEO_NUMBER; i++) {
+        g->slot[i] = GRAPH_NO_SLOT;
     }
 }
 
+static void graphics_graph_free_compiled(Graph *g) {
+    free(g->edge_offset);
+    free(g->edge_node);
+    free(g->edge_pad);
+    free(g->dep_offset);
+    free(g->dep_node);
+    free(g->order);
+    free(g->order_index);
+    free(g->dirty);
+    free(g->stack);
+}
+
+void graphics_free_graph(Graph *g) {
+    graphics_graph_free_compiled(g);
+    free(g->node);
+    free(g->edge);
+    free(g->slot);
+
+    memset(g, 0, sizeof( Graph ));
+}
+
 uint64_t graphics_graph_size(Graph *g) {
-    uint64_t node_size = (g->num_nodes + 2 * g->node_count) * sizeof( Node );
-    uint64_t edge_size = g->num_edges * sizeof( Edge );
+    uint64_t node_size = g->nodes_capacity * sizeof( Node );
+    uint64_t edge_size = g->edges_capacity * sizeof( Edge );
+    uint64_t slot_size = g->node_count * GEO_NUMBER * sizeof( uint32_t );
     uint64_t graph_size = sizeof( Graph );
+    uint64_t compiled_size = 0;
 
-    return node_size + edge_size + graph_size;
+    if (g->compiled) {
+        compiled_size += g->num_nodes * 6 * sizeof( size_t ) + 2 * sizeof( size_t );
+        compiled_size += g->num_edges * (2 * sizeof( size_t ) + sizeof( unsigned char ));
+    }
+
+    return node_size + edge_size + slot_size + graph_size + compiled_size;
 }
 
-static Node *graphics_graph_create_node(Graph *g, GeometryAttr attr) {
-    Node *node = ARENA_ALLOC(g->arena, Node);
-    node->edge_list_head.next = &node->edge_list_tail;
-    node->edge_list_head.prev = NULL;
-    node->edge_list_tail.next = NULL;
-    node->edge_list_tail.prev = &node->edge_list_head;
+/*
+ * Add a node for attr at index, returns the node id, 
+ * or GRAPH_NO_NODE if attr has no slot.
+ */
+static size_t graphics_graph_create_node(Graph *g, size_t index, GeometryAttr attr) {
+    if (attr >= GEO_NUMBER) {
+        log_file(LogError, "Graph", "Attr %s cannot be a node", geometry_attr_to_char(attr));
+        return GRAPH_NO_NODE;
+    }
+
+    log_assert(g->num_nodes < GRAPH_NO_SLOT, "Graph", "Too many graph nodes");
+
+    if (g->num_nodes == g->nodes_capacity) {
+        g->nodes_capacity = MAX(2 * g->nodes_capacity, 64);
+        g->node = realloc(g->node, g->nodes_capacity * sizeof( Node ));
+        log_assert(g->node != NULL, "Graph", "Unable to allocate graph nodes");
+    }
+
+    size_t id = g->num_nodes++;
+    Node *node = &g->node[id];
 
+    memset(node, 0, sizeof( Node ));
     node->attr = attr;
-    g->num_nodes++;
 
-    return node;
+    // lookups return the first node added for an attr
+    if (g->slot[index * GEO_NUMBER + attr] == GRAPH_NO_SLOT) {
+        g->slot[index * GEO_NUMBER + attr] = id;
+    }
+
+    g->compiled = 0;
+
+    return id;
 }
 
-Node *graphics_graph_get_node(Graph *g, size_t index, GeometryAttr attr) {
+/*
+ * Id of the first node added for attr at index,
+ * or GRAPH_NO_NODE.
+ */
+size_t graphics_graph_node_id(Graph *g, size_t index, GeometryAttr attr) {
     log_assert(index < g->node_count, "Graphics", "Index out of range " __FILE__);
 
-    Node *head = &g->node_list_head[index];
-    Node *tail = &g->node_list_tail[index];
+    if (attr >= GEO_NUMBER) {
+        return GRAPH_NO_NODE;
+    }
 
-    for (Node *node = head->next; node != tail; node = node->next) {
-        if (node->attr != attr) {
-            continue;
-        }
+    uint32_t id = g->slot[index * GEO_NUMBER + attr];
+    return (id == GRAPH_NO_SLOT) ? GRAPH_NO_NODE : id;
+}
 
-        return node;
+/*
+ * Node of attr at index, or NULL. Only valid until 
+ * the next node is added.
+ */
+Node *graphics_graph_get_node(Graph *g, size_t index, GeometryAttr attr) {
+    size_t id = graphics_graph_node_id(g, index, attr);
+    if (id == GRAPH_NO_NODE) {
+        return NULL;
     }
 
-    return NULL;
+    return &g->node[id];
 }
 
 void graphics_graph_add_eval_node(Graph *g, size_t x, GeometryAttr attr, NodeEval eval) {
     if (x < 0 || x >= g->node_count) {
         log_file(LogError, "Graph", "Index out of range: adding eval node %d", x);
+        return;
     }
 
-    Node *node = graphics_graph_create_node(g, attr);
+    size_t id = graphics_graph_create_node(g, x, attr);
+    if (id == GRAPH_NO_NODE) {
+        return;
+    }
+
+    Node *node = &g->node[id];
     node->eval = eval;
     node->evaluated = 0;
-
-    INSERT_BEFORE(node, &g->node_list_tail[x]);
 }
 
 void graphics_graph_add_leaf_node(Graph *g, size_t x, GeometryAttr attr, float value) {
     if (x < 0 || x >= g->node_count) {
         log_file(LogError, "Graph", "Index out of range: adding leaf node %d", x);
+        return;
+    }
+
+    size_t id = graphics_graph_create_node(g, x, attr);
+    if (id == GRAPH_NO_NODE) {
+        return;
     }
 
-    Node *node = graphics_graph_create_node(g, attr);
+    Node *node = &g->node[id];
     node->eval = EVAL_LEAF;
     node->evaluated = 1;
     node->value = value;
+}
 
-    INSERT_BEFORE(node, &g->node_list_tail[x]);
+/*
+ * Queue a node which changed since the last evaluation, 
+ * the next evaluation only updates the nodes which 
+ * depend on the dirty nodes.
+ */
+static void graphics_graph_mark_dirty(Graph *g, size_t id) {
+    Node *node = &g->node[id];
+
+    if (!g->compiled || g->evaluate_all || node->dirty) {
+        return;
+    }
+
+    node->dirty = 1;
+    g->dirty[g->num_dirty++] = id;
 }
 
 void graphics_graph_update_leaf(Graph *g, size_t x, GeometryAttr attr, float value) {
-    Node *node = graphics_graph_get_node(g, x, attr);
-    if (node == NULL) {
+    size_t id = graphics_graph_node_id(g, x, attr);
+    if (id == GRAPH_NO_NODE) {
         graphics_graph_add_leaf_node(g, x, attr, value);
         return;
     }
 
-    node->value = value;
+    if (g->node[id].value == value) {
+        return;
+    }
+
+    // non leaf nodes are marked so the next evaluation
+    // restores the computed value
+    g->node[id].value = value;
+    graphics_graph_mark_dirty(g, id);
 }
 
+/*
+ * Add an edge from the node of x_attr at x to the node
+ * of y_attr at y. The edge is only valid until the 
+ * next edge is added.
+ */
 Edge *graphics_graph_add_edge(Graph *g, size_t x, GeometryAttr x_attr, 
                              size_t y, GeometryAttr y_attr) {
     if (x < 0 || x >= g->node_count) {
@@ -105,36 +210,40 @@ Edge *graphics_graph_add_edge(Graph *g, size_t x, GeometryAttr x_attr,
         log_file(LogError, "Graph", "Index out of range: adding edge to %d", y);
     }
 
-    Node *node = graphics_graph_get_node(g, x, x_attr);
-    if (node == NULL) {
+    size_t id = graphics_graph_node_id(g, x, x_attr);
+    if (id == GRAPH_NO_NODE) {
         log_file(LogError, "Graph", "Adding edge from node %d attr %s which does not exist", 
                  x, geometry_attr_to_char(x_attr));
     }
 
-    Edge *edge = ARENA_ALLOC(g->arena, Edge);
+    if (g->num_edges == g->edges_capacity) {
+        g->edges_capacity = MAX(2 * g->edges_capacity, 64);
+        g->edge = realloc(g->edge, g->edges_capacity * sizeof( Edge ));
+        log_assert(g->edge != NULL, "Graph", "Unable to allocate graph edges");
+    }
+
+    Edge *edge = &g->edge[g->num_edges++];
+    edge->node = id;
     edge->index = y;
     edge->attr = y_attr;
     edge->pad = 0;
 
-    INSERT_BEFORE(edge, &node->edge_list_tail);
-    g->num_edges++;
+    g->compiled = 0;
     return edge;
 }
 
-static unsigned char graphics_graph_depth_first(Graph *g, Node *node) {
-    Edge *head = &node->edge_list_head;
-    Edge *tail = &node->edge_list_tail;
+static unsigned char graphics_graph_depth_first(Graph *g, size_t id) {
     unsigned char is_dag = 1;
 
-    node->discovered = 1;
+    g->node[id].discovered = 1;
 
-    for (Edge *edge = head->next; edge != tail; edge = edge->next) {
-        Node *adj = graphics_graph_get_node(g, edge->index, edge->attr);
-        if (adj == NULL || adj->visited) {
+    for (size_t i = g->edge_offset[id]; i < g->edge_offset[id + 1]; i++) {
+        size_t adj = g->edge_node[i];
+        if (adj == GRAPH_NO_NODE || g->node[adj].visited) {
             continue;
         }
 
-        if (adj->discovered) {
+        if (g->node[adj].discovered) {
             is_dag = 0;
             continue;
         }
@@ -142,218 +251,389 @@ static unsigned char graphics_graph_depth_first(Graph *g, Node *node) {
         is_dag = is_dag && graphics_graph_depth_first(g, adj);
     }
 
-    node->discovered = 0;
-    node->visited = 1;
+    g->node[id].discovered = 0;
+    g->node[id].visited = 1;
     return is_dag;
 }
 
 unsigned char graphics_graph_is_dag(Graph *g) {
     unsigned char is_dag = 1;
 
+    if (!g->compiled) {
+        graphics_graph_compile(g);
+    }
+
     // zero visited values
-    for (size_t i = 0; i < g->node_count; i++) {
-        Node *head = &g->node_list_head[i];
-        Node *tail = &g->node_list_tail[i];
+    for (size_t id = 0; id < g->num_nodes; id++) {
+        g->node[id].visited = 0;
+        g->node[id].discovered = 0;
+    }
+
+    for (size_t id = 0; id < g->num_nodes; id++) {
+        if (g->node[id].visited) {
+            continue;
+        }
+        
+        is_dag = is_dag && graphics_graph_depth_first(g, id);
+    }
+
+    return is_dag;
+}
 
-        for (Node *node = head->next; node != tail; node = node->next) {
-            node->visited = 0;
-            node->discovered = 0;
+/*
+ * Compile the graph into a flat layout for evaluation.
+ *
+ * The edges are stored in CSR form with the node id 
+ * of the target resolved, and the non leaf nodes are 
+ * sorted topologically so each node is evaluated 
+ * after the nodes it depends on.
+ *
+ * The reversed edges are also stored in CSR form, so
+ * an evaluation after graphics_graph_update_leaf only 
+ * visits the dependents of the updated leaves.
+ *
+ * Adding nodes or edges to the graph marks it as not
+ * compiled, and it is recompiled (and fully evaluated)
+ * on the next evaluation.
+ */
+
+static void graphics_graph_topological_sort(Graph *g, size_t id) {
+    Node *node = &g->node[id];
+    node->visited = 1;
+
+    for (size_t i = g->edge_offset[id]; i < g->edge_offset[id + 1]; i++) {
+        size_t adj = g->edge_node[i];
+        if (adj == GRAPH_NO_NODE || g->node[adj].visited) {
+            continue;
         }
+
+        graphics_graph_topological_sort(g, adj);
     }
 
-    for (size_t i = 0; i < g->node_count; i++) {
-        Node *head = &g->node_list_head[i];
-        Node *tail = &g->node_list_tail[i];
+    if (node->eval != EVAL_LEAF) {
+        g->order[g->num_order++] = id;
+    }
+}
 
-        for (Node *node = head->next; node != tail; node = node->next) {
-            if (node->visited) {
+void graphics_graph_compile(Graph *g) {
+    size_t id;
+
+    graphics_graph_free_compiled(g);
+
+    g->edge_offset = NEW_ARRAY(g->num_nodes + 1, size_t);
+    g->edge_node = NEW_ARRAY(g->num_edges, size_t);
+    g->edge_pad = NEW_ARRAY(g->num_edges, unsigned char);
+    g->dep_offset = NEW_ARRAY(g->num_nodes + 1, size_t);
+    g->dep_node = NEW_ARRAY(g->num_edges, size_t);
+    g->order = NEW_ARRAY(g->num_nodes, size_t);
+    g->order_index = NEW_ARRAY(g->num_nodes, size_t);
+    g->dirty = NEW_ARRAY(g->num_nodes, size_t);
+    g->stack = NEW_ARRAY(g->num_nodes, size_t);
+    g->num_order = 0;
+    g->num_dirty = 0;
+
+    for (id = 0; id < g->num_nodes; id++) {
+        g->node[id].visited = 0;
+        g->node[id].dirty = 0;
+    }
+
+    // edges grouped by node in the order they were added,
+    // edge_offset[id + 1] counts the edges of id and is then
+    // used as the insert position while filling edge_node
+    memset(g->edge_offset, 0, (g->num_nodes + 1) * sizeof( size_t ));
+
+    for (size_t i = 0; i < g->num_edges; i++) {
+        g->edge_offset[g->edge[i].node + 1]++;
+    }
+
+    for (id = 0; id < g->num_nodes; id++) {
+        g->edge_offset[id + 1] += g->edge_offset[id];
+    }
+
+    for (size_t i = 0; i < g->num_edges; i++) {
+        Edge *edge = &g->edge[i];
+        size_t j = g->edge_offset[edge->node]++;
+
+        g->edge_node[j] = graphics_graph_node_id(g, edge->index, edge->attr);
+        g->edge_pad[j] = edge->pad;
+    }
+
+    for (id = g->num_nodes; id > 0; id--) {
+        g->edge_offset[id] = g->edge_offset[id - 1];
+    }
+
+    g->edge_offset[0] = 0;
+
+    // reversed edges, filled the same way
+    memset(g->dep_offset, 0, (g->num_nodes + 1) * sizeof( size_t ));
+
+    for (size_t i = 0; i < g->num_edges; i++) {
+        if (g->edge_node[i] != GRAPH_NO_NODE) {
+            g->dep_offset[g->edge_node[i] + 1]++;
+        }
+    }
+
+    for (id = 0; id < g->num_nodes; id++) {
+        g->dep_offset[id + 1] += g->dep_offset[id];
+    }
+
+    for (id = 0; id < g->num_nodes; id++) {
+        for (size_t i = g->edge_offset[id]; i < g->edge_offset[id + 1]; i++) {
+            size_t adj = g->edge_node[i];
+            if (adj == GRAPH_NO_NODE) {
                 continue;
             }
-            
-            is_dag = is_dag && graphics_graph_depth_first(g, node);
+
+            g->dep_node[g->dep_offset[adj]++] = id;
         }
     }
 
-    return is_dag;
-}
+    for (id = g->num_nodes; id > 0; id--) {
+        g->dep_offset[id] = g->dep_offset[id - 1];
+    }
+
+    g->dep_offset[0] = 0;
+
+    for (id = 0; id < g->num_nodes; id++) {
+        g->order_index[id] = GRAPH_NO_NODE;
+    }
+
+    for (id = 0; id < g->num_nodes; id++) {
+        if (g->node[id].visited) {
+            continue;
+        }
 
-static float single_value(Graph *g, Node *node) {
-    if (node->edge_list_head.next == &node->edge_list_tail) {
-        log_file(LogError, "Graphics", "Node %s has no values, expected 1", geometry_attr_to_char(node->attr));
+        graphics_graph_topological_sort(g, id);
     }
 
-    Edge *edge = node->edge_list_head.next;
-    Node *adj = graphics_graph_get_node(g, edge->index, edge->attr);
+    for (size_t i = 0; i < g->num_order; i++) {
+        g->order_index[g->order[i]] = i;
+    }
+
+    g->compiled = 1;
+    g->evaluate_all = 1;
+}
 
-    if (adj == NULL) {
-        log_file(LogWarn, "Graphics", "Missing node %d %s", edge->index, geometry_attr_to_char(edge->attr));
+static void graphics_graph_missing_node(Graph *g, size_t id) {
+    log_file(LogWarn, "Graphics", "Node %s has an edge to a missing node", 
+             geometry_attr_to_char(g->node[id].attr));
+}
+
+static float single_value(Graph *g, size_t id) {
+    size_t start = g->edge_offset[id];
+
+    if (start == g->edge_offset[id + 1]) {
+        log_file(LogError, "Graphics", "Node %s has no values, expected 1", geometry_attr_to_char(g->node[id].attr));
         return 0;
     }
 
-    return adj->value;
+    size_t adj = g->edge_node[start];
+    if (adj == GRAPH_NO_NODE) {
+        graphics_graph_missing_node(g, id);
+        return 0;
+    }
+
+    return g->node[adj].value;
 }
 
-static float min_value(Graph *g, Node *node) {
+static float min_value(Graph *g, size_t id) {
     float value = INT_MAX;
 
-    for (Edge *edge = node->edge_list_head.next; edge != &node->edge_list_tail; edge = edge->next) {
-        Node *adj = graphics_graph_get_node(g, edge->index, edge->attr);
-        if (adj == NULL) {
-            log_file(LogWarn, "Graphics", "Missing node %d %s", edge->index, geometry_attr_to_char(edge->attr));
+    for (size_t i = g->edge_offset[id]; i < g->edge_offset[id + 1]; i++) {
+        size_t adj = g->edge_node[i];
+        if (adj == GRAPH_NO_NODE) {
+            graphics_graph_missing_node(g, id);
             continue;
         }
 
-        if (!adj->evaluated) {
+        if (!g->node[adj].evaluated) {
             continue;
         }
         
-        value = MIN(value, adj->value);
+        value = MIN(value, g->node[adj].value);
     }
 
     if (value == INT_MAX) {
-        log_file(LogError, "Graphics", "Node %s missing values", geometry_attr_to_char(node->attr));
+        log_file(LogError, "Graphics", "Node %s missing values", geometry_attr_to_char(g->node[id].attr));
     }
 
     return value;
 }
 
-static float max_value(Graph *g, Node *node) {
+static float max_value(Graph *g, size_t id) {
     float value = INT_MIN;
 
-    for (Edge *edge = node->edge_list_head.next; edge != &node->edge_list_tail; edge = edge->next) {
-        Node *adj = graphics_graph_get_node(g, edge->index, edge->attr);
-        if (adj == NULL) {
-            log_file(LogWarn, "Graphics", "Missing node %d %s", edge->index, geometry_attr_to_char(edge->attr));
+    for (size_t i = g->edge_offset[id]; i < g->edge_offset[id + 1]; i++) {
+        size_t adj = g->edge_node[i];
+        if (adj == GRAPH_NO_NODE) {
+            graphics_graph_missing_node(g, id);
             continue;
         }
 
-        if (!adj->evaluated) {
+        if (!g->node[adj].evaluated) {
             continue;
         }
         
-        value = MAX(value, adj->value);
+        value = MAX(value, g->node[adj].value);
     }
 
     if (value == INT_MIN) {
-        log_file(LogError, "Graphics", "Node %s missing values", geometry_attr_to_char(node->attr));
+        log_file(LogError, "Graphics", "Node %s missing values", geometry_attr_to_char(g->node[id].attr));
     }
 
     return value;
 }
 
-static float max_value_plus_pad(Graph *g, Node *node) {
+static float max_value_plus_pad(Graph *g, size_t id) {
     float value = INT_MIN;
     float pad = 0;
 
-    for (Edge *edge = node->edge_list_head.next; edge != &node->edge_list_tail; edge = edge->next) {
-        Node *adj = graphics_graph_get_node(g, edge->index, edge->attr);
-        if (adj == NULL) {
-            log_file(LogWarn, "Graphics", "Missing node %d %s", edge->index, geometry_attr_to_char(edge->attr));
+    for (size_t i = g->edge_offset[id]; i < g->edge_offset[id + 1]; i++) {
+        size_t adj = g->edge_node[i];
+        if (adj == GRAPH_NO_NODE) {
+            graphics_graph_missing_node(g, id);
             continue;
         }
 
-        if (!adj->evaluated) {
+        if (!g->node[adj].evaluated) {
             continue;
         }
         
-        if (edge->pad) {
-            pad += adj->value;
+        if (g->edge_pad[i]) {
+            pad += g->node[adj].value;
         } else {
-            value = MAX(value, adj->value);
+            value = MAX(value, g->node[adj].value);
         }
     }
 
     if (value == INT_MIN) {
-        log_file(LogError, "Graphics", "Node %s missing values", geometry_attr_to_char(node->attr));
+        log_file(LogError, "Graphics", "Node %s missing values", geometry_attr_to_char(g->node[id].attr));
     }
 
     return value + pad;
 }
 
-static float sum_value(Graph *g, Node *node) {
+static float sum_value(Graph *g, size_t id) {
     float value = 0; 
 
-    for (Edge *edge = node->edge_list_head.next; edge != &node->edge_list_tail; edge = edge->next) {
-        Node *adj = graphics_graph_get_node(g, edge->index, edge->attr);
-        if (adj == NULL) {
-            log_file(LogWarn, "Graphics", "Missing node %d %s", edge->index, geometry_attr_to_char(edge->attr));
+    for (size_t i = g->edge_offset[id]; i < g->edge_offset[id + 1]; i++) {
+        size_t adj = g->edge_node[i];
+        if (adj == GRAPH_NO_NODE) {
+            graphics_graph_missing_node(g, id);
             continue;
         }
 
-        if (!adj->evaluated) {
+        if (!g->node[adj].evaluated) {
             continue;
         }
         
-        value += adj->value;
+        value += g->node[adj].value;
     }
 
     return value;
 }
 
-static float graphics_graph_eval(Graph *g, Node *n) {
-    switch (n->eval) {
+static float graphics_graph_eval(Graph *g, size_t id) {
+    switch (g->node[id].eval) {
         case EVAL_LEAF:
             log_file(LogError, "Graphics", "Cannot evaluate leaf node");
             return 0;
         case EVAL_SINGLE_VALUE:
-            return single_value(g, n);
+            return single_value(g, id);
         case EVAL_MIN_VALUE:
-            return min_value(g, n);
+            return min_value(g, id);
         case EVAL_MAX_VALUE:
-            return max_value(g, n);
+            return max_value(g, id);
         case EVAL_MAX_VALUE_PAD:
-            return max_value_plus_pad(g, n);
+            return max_value_plus_pad(g, id);
         case EVAL_SUM_VALUE:
-            return sum_value(g, n);
+            return sum_value(g, id);
     }
+
+    return 0;
 }
 
+static int graphics_graph_compare_index(const void *a, const void *b) {
+    size_t x = *(const size_t *) a;
+    size_t y = *(const size_t *) b;
 
-static void graphics_graph_evaluate_node(Graph *g, Node *node) {
-    if (node->evaluated || node->eval == EVAL_LEAF) {
-        return;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Re-evaluate the nodes downstream of the dirty nodes.
+ * The dependents are collected with a depth first search
+ * over the reversed edges, and evaluated in topological 
+ * order. Nodes are only collected once, using the dirty
+ * flag as the visited marker.
+ */
+static void graphics_graph_evaluate_dirty(Graph *g) {
+    size_t top = 0, num_affected = 0;
+
+    for (size_t i = 0; i < g->num_dirty; i++) {
+        g->stack[top++] = g->dirty[i];
     }
 
-    for (Edge *edge = node->edge_list_head.next; edge != &node->edge_list_tail; edge = edge->next) {
-        Node *adj = graphics_graph_get_node(g, edge->index, edge->attr);
-        if (adj == NULL) {
-            continue;
-        }
+    g->num_dirty = 0;
 
-        if (adj->evaluated) {
-            continue;
+    while (top > 0) {
+        size_t id = g->stack[--top];
+
+        if (g->order_index[id] == GRAPH_NO_NODE) {
+            // leaf nodes are never a dependent
+            g->node[id].dirty = 0;
+        } else {
+            g->dirty[num_affected++] = g->order_index[id];
         }
 
-        graphics_graph_evaluate_node(g, adj);
+        for (size_t i = g->dep_offset[id]; i < g->dep_offset[id + 1]; i++) {
+            Node *dep = &g->node[g->dep_node[i]];
+            if (dep->dirty) {
+                continue;
+            }
+
+            dep->dirty = 1;
+            g->stack[top++] = g->dep_node[i];
+        }
     }
 
-    node->value = graphics_graph_eval(g, node);
-    node->evaluated = 1;
+    qsort(g->dirty, num_affected, sizeof( size_t ), graphics_graph_compare_index);
+
+    for (size_t i = 0; i < num_affected; i++) {
+        size_t id = g->order[g->dirty[i]];
+
+        g->node[id].value = graphics_graph_eval(g, id);
+        g->node[id].dirty = 0;
+    }
 }
 
+/*
+ * Evaluate the non leaf nodes of the graph. The first
+ * evaluation after compiling evaluates every node, later
+ * evaluations only update the dependents of the nodes 
+ * changed by graphics_graph_update_leaf.
+ */
 void graphics_graph_evaluate_dag(Graph *g) {
-    Node *head, *tail;
-
-    // reset evaluation
-    for (size_t i = 0; i < g->node_count; i++) {
-        head = &g->node_list_head[i];
-        tail = &g->node_list_tail[i];
+    if (!g->compiled) {
+        graphics_graph_compile(g);
+    }
 
-        for (Node *node = head->next; node != tail; node = node->next) {
-            if (node->eval == EVAL_LEAF) {
-                continue;
-            }
+    if (!g->evaluate_all) {
+        graphics_graph_evaluate_dirty(g);
+        return;
+    }
 
-            node->evaluated = 0;
-        }
+    // reset evaluation
+    for (size_t i = 0; i < g->num_order; i++) {
+        g->node[g->order[i]].evaluated = 0;
     }
 
-    for (size_t i = 0; i < g->node_count; i++) {
-        head = &g->node_list_head[i];
-        tail = &g->node_list_tail[i];
+    for (size_t i = 0; i < g->num_order; i++) {
+        size_t id = g->order[i];
 
-        for (Node *node = head->next; node != tail; node = node->next) {
-            graphics_graph_evaluate_node(g, node);
-        }
+        g->node[id].value = graphics_graph_eval(g, id);
+        g->node[id].evaluated = 1;
     }
+
+    g->evaluate_all = 0;
 }
@@ -14,6 +14,7 @@
 #include "glib.h"
 #include "graphics.h"
 #include "graphics_internal.h"
+#include <time.h>
 
 void graphics_new_graphics_hub(IGraphics *hub, int num_pages) {
     g_mutex_init(&hub->lock);
@@ -22,11 +23,14 @@ void graphics_new_graphics_hub(IGraphics *hub, int num_pages) {
     hub->count = 0;
     hub->items = NEW_ARRAY(hub->capacity, IPage *);
 
+    g_mutex_init(&hub->img_lock);
     for (int i = 0; i < MAX_ASSETS; i++) {
         hub->img[i].data = NULL;
+        hub->img[i].version = 0;
+        hub->img[i].loaded = 0;
     }
 
-    ARENA_INIT(&hub->arena, GIGABYTES((uint64_t) 4));
+    ARENA_INIT(&hub->arena, HUB_BLOCK_SIZE);
 }
 
 IPage *graphics_hub_new_page(IGraphics *hub, int num_geo, int max_keyframe, int temp_id) {
@@ -70,6 +74,41 @@ IPage *graphics_hub_get_page(IGraphics *hub, int temp_id) {
     return page;
 }
 
+/*
+ * Calculate the keyframes and publish each page 
+ * marked as pending by graphics_page_mark_pending.
+ * Pages are never removed from the hub, so the page
+ * lock is taken without holding the hub lock.
+ */
+void graphics_hub_flush_pages(IGraphics *hub) {
+    g_mutex_lock(&hub->lock);
+    size_t count = hub->count;
+    g_mutex_unlock(&hub->lock);
+
+    for (size_t i = 0; i < count; i++) {
+        g_mutex_lock(&hub->lock);
+        IPage *page = hub->items[i];
+        g_mutex_unlock(&hub->lock);
+
+        if (!g_atomic_int_get(&page->pending)) {
+            continue;
+        }
+
+        g_mutex_lock(&page->lock);
+        if (g_atomic_int_get(&page->pending)) {
+            clock_t start = clock();
+            graphics_page_calculate_keyframes(page);
+            graphics_page_publish(page);
+            g_atomic_int_set(&page->pending, 0);
+            clock_t end = clock();
+
+            log_file(LogMessage, "Graphics", "Calculated keyframes of page %d in %f ms", 
+                     page->temp_id, ((double) (end - start) * 1000) / CLOCKS_PER_SEC);
+        }
+        g_mutex_unlock(&page->lock);
+    }
+}
+
 void graphics_free_graphics_hub(IGraphics *hub) {
     if (hub == NULL) {
         return;
@@ -82,5 +121,13 @@ void graphics_free_graphics_hub(IGraphics *hub) {
     }
 
     free(hub->items);
+    arena_free(&hub->arena);
+
+    g_mutex_lock(&hub->img_lock);
+    for (int i = 0; i < MAX_ASSETS; i++) {
+        free(hub->img[i].data);
+        hub->img[i].data = NULL;
+    }
+    g_mutex_unlock(&hub->img_lock);
     g_mutex_unlock(&hub->lock);
 }
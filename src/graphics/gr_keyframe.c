@@ -39,14 +39,18 @@ static void graphics_log_keyframe(IPage *page) {
 
         for (int frame_num = 0; frame_num < page->max_keyframe; frame_num++) {
             int frame_index = frame_num * page->len_geometry + geo_id;
-            Node *head = &page->keyframe_graph.node_list_head[frame_index];
-            Node *tail = &page->keyframe_graph.node_list_tail[frame_index];
+            Graph *g = &page->keyframe_graph;
 
             log_file(LogMessage, "Graphics", "\t\tFrame %d", frame_num); 
 
-            for (Node *node = head->next; node != tail; node = node->next) {
+            for (GeometryAttr attr = 0; attr < GEO_NUMBER; attr++) {
+                size_t id = graphics_graph_node_id(g, frame_index, attr);
+                if (id == GRAPH_NO_NODE) {
+                    continue;
+                }
+
                 log_file(LogMessage, "Graphics", "\t\t\tAttr %s: %f", 
-                         geometry_attr_to_char(node->attr), node->value);
+                         geometry_attr_to_char(g->node[id].attr), g->node[id].value);
             }
         }
     }
@@ -83,7 +87,13 @@ void graphics_page_calculate_keyframes(IPage *page) {
         // calculate frames
         start = clock();
 
+        if (!page->keyframe_graph.compiled) {
+            // graph has changed, rebuild the tracks
+            page->tracks.baked = 0;
+        }
+
         graphics_graph_evaluate_dag(&page->keyframe_graph);
+        graphics_page_update_tracks(page);
 
         end = clock();
         if (LOG_KEYFRAMES) {
@@ -206,6 +216,8 @@ void graphics_page_default_relations(IPage *page) {
         geometry_graph_add_values(geo, add_attribute);
     }
 
+    graphics_graph_compile(&page->keyframe_graph);
+    page->tracks.baked = 0;
     graphics_log_keyframe(page);
 } 
 
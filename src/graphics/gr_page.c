@@ -10,10 +10,11 @@
 
 #include "arena.h"
 #include "graphics_internal.h"
+#include <inttypes.h>
 
 void graphics_page_init_arena(IPage *page) {
     g_mutex_lock(&page->lock);
-    ARENA_INIT(&page->arena, MAX_PAGE_SIZE);
+    ARENA_INIT(&page->arena, PAGE_BLOCK_SIZE);
     g_mutex_unlock(&page->lock);
 }
 
@@ -21,7 +22,7 @@ void graphics_init_page(IPage *page, int temp_id, int num_geo, int max_keyframe)
     log_assert(page != NULL, "Graphics", "Page init requires a page");
 
     g_mutex_lock(&page->lock);
-    log_assert(page->arena.memory != NULL, "Graphics", "Page init requires arena to be allocated");
+    log_assert(page->arena.block_size != 0, "Graphics", "Page init requires arena to be allocated");
 
     page->temp_id = temp_id;
     page->len_geometry = num_geo;
@@ -29,7 +30,8 @@ void graphics_init_page(IPage *page, int temp_id, int num_geo, int max_keyframe)
     page->geometry = ARENA_ARRAY(&page->arena, num_geo, IGeometry *);
 
     int n = page->max_keyframe * page->len_geometry;
-    graphics_new_graph(&page->arena, &page->keyframe_graph, n);
+    graphics_new_graph(&page->keyframe_graph, n);
+    page->tracks.baked = 0;
 
     IGeometry *geo = graphics_page_add_geometry(page, RECT, 0);
     geo->parent_id = -1;
@@ -60,23 +62,55 @@ IGeometry *graphics_page_add_geometry(IPage *page, int type, int geo_id) {
     return geo;
 }
 
+/*
+ * Free the geometry and keyframes of the page, the
+ * page lock is held so a flush of the page does not
+ * use the freed graph, and a pending flush is dropped.
+ */
 void graphics_page_clear(IPage *page) {
     if (page == NULL) {
         return;
     }
 
-    double arena_usage = (double) page->arena.allocd * 100 / page->arena.size;
-    uint64_t usage_size = page->arena.allocd / MEGABYTES((uint64_t)1);
-    uint64_t arena_size = page->arena.size / MEGABYTES((uint64_t)1);
+    g_mutex_lock(&page->lock);
+    graphics_page_log_usage(page);
+    graphics_free_graph(&page->keyframe_graph);
+    arena_reset(&page->arena);
+
+    page->len_geometry = 0;
+    page->tracks.baked = 0;
+    g_atomic_int_set(&page->pending, 0);
+    g_mutex_unlock(&page->lock);
+}
+
+/*
+ * Mark the keyframe graph of the page as updated,
+ * called with the page lock held. The keyframes 
+ * are calculated and published by the next 
+ * graphics_hub_flush_pages, so a burst of updates 
+ * to a page only calculates the keyframes once.
+ */
+void graphics_page_mark_pending(IPage *page) {
+    g_atomic_int_set(&page->pending, 1);
+}
+
+/*
+ * Log the memory used by the page arena and 
+ * keyframe graph.
+ */
+void graphics_page_log_usage(IPage *page) {
+    Arena *a = &page->arena;
+    double arena_usage = (a->reserved == 0) ? 0 : (double) a->allocd * 100 / a->reserved;
+    uint64_t usage_size = a->allocd / KILOBYTES((uint64_t)1);
+    uint64_t peak_size = a->peak / KILOBYTES((uint64_t)1);
+    uint64_t arena_size = a->reserved / KILOBYTES((uint64_t)1);
     uint64_t graph_size = graphics_graph_size(&page->keyframe_graph) / MEGABYTES((uint64_t)1);
 
     log_file(LogMessage, "Graphics", "Page %d", page->temp_id); 
     log_file(LogMessage, "Graphics", "\tNum Geo %d", page->len_geometry);
-    log_file(LogMessage, "Graphics", "\tArena %f %% (%lu out of %lu MB)", arena_usage, usage_size, arena_size);
-    log_file(LogMessage, "Graphics", "\tGraph %lu nodes, %lu MB", page->keyframe_graph.num_nodes, graph_size);
-
-    page->arena.allocd = 0;
-    page->len_geometry = 0;
+    log_file(LogMessage, "Graphics", "\tArena %f %% (%" PRIu64 " out of %" PRIu64 " KB in %" PRIu64 " blocks, peak %" PRIu64 " KB)", 
+             arena_usage, usage_size, arena_size, a->num_blocks, peak_size);
+    log_file(LogMessage, "Graphics", "\tGraph %zu nodes, %" PRIu64 " MB", page->keyframe_graph.num_nodes, graph_size);
 }
 
 int graphics_page_free_page(IPage *page) {
@@ -84,48 +118,9 @@ int graphics_page_free_page(IPage *page) {
         return 0;
     }
 
-    return munmap(page->arena.memory, page->arena.allocd);
-}
-
-void graphics_page_interpolate_geometry(IPage *page, int index, int width) {
-    IGeometry *geo;
-    Node *head, *tail;
-    int k_index, k1_index;
-    int frame_start = index / width;
-    int frame_index = index % width;
-    double next_value;
-
-    for (int geo_id = 0; geo_id < page->len_geometry; geo_id++) {
-        geo = page->geometry[geo_id];
-        if (geo == NULL) {
-            continue;
-        }
-
-        k_index = frame_start * page->len_geometry + geo_id;
-        k1_index = (frame_start + 1) * page->len_geometry + geo_id;
-        head = &page->keyframe_graph.node_list_head[k_index];
-        tail = &page->keyframe_graph.node_list_tail[k_index];
-
-        for (Node *node = head->next; node != tail; node = node->next) {
-            if (!node->evaluated) {
-                continue;
-            }
-
-            if (frame_start == page->max_keyframe - 1) {
-                geometry_set_float_attr(geo, node->attr, node->value);
-                continue;
-            } 
-
-            Node *next_node = graphics_graph_get_node(&page->keyframe_graph, k1_index, node->attr);
-            if (next_node == NULL) {
-                next_node = node;
-            }
-
-            next_value = graphics_keyframe_interpolate(
-                node->value, next_node->value, frame_index, width
-            );
-
-            geometry_set_float_attr(geo, node->attr, next_value);
-        }
-    }
+    graphics_tracks_free(&page->tracks);
+    graphics_free_graph(&page->keyframe_graph);
+    graphics_page_free_snapshots(page);
+    arena_free(&page->arena);
+    return 0;
 }
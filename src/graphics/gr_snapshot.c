@@ -0,0 +1,280 @@
+/*
+ * gr_snapshot.c
+ *
+ * Page snapshots, used to hand a page from the
+ * parser threads to the render thread without
+ * the render thread taking the page lock.
+ *
+ *      void graphics_page_publish(IPage *page);
+ *      PageSnapshot *graphics_page_snapshot(IPage *page);
+ *
+ *      void graphics_snapshot_begin_read(void);
+ *      void graphics_snapshot_end_read(void);
+ *
+ * After calculating the keyframes of a page, the
+ * parser (holding the page lock) calls
+ * graphics_page_publish, which copies the geometry
+ * and interpolation tracks of the page into a new
+ * snapshot and swaps it into page->snapshot.
+ *
+ * The render thread loads page->snapshot between
+ * graphics_snapshot_begin_read and
+ * graphics_snapshot_end_read, which bump a read
+ * epoch (odd while reading). A replaced snapshot
+ * is retired with the epoch at the time of the
+ * swap, and freed by a later publish once the
+ * render thread has left that read. Snapshots are
+ * only modified by the render thread, when
+ * interpolating the geometry.
+ *
+ * Each snapshot has a unique serial, so the renderer
+ * can keep data derived from a snapshot between 
+ * frames.
+ *
+ * The snapshot also stores the children of each 
+ * geometry, so the renderer can walk the hierarchy
+ * without searching the geometry for children. This 
+ * is built when publishing, and again after each 
+ * interpolation if a parent or mask is keyframed.
+ *
+ * There is a single reader, the render thread.
+ *
+ */
+
+#include "graphics_internal.h"
+
+static gint read_epoch = 0;
+static gint next_serial = 0;
+
+void graphics_snapshot_begin_read(void) {
+    g_atomic_int_inc(&read_epoch);
+}
+
+void graphics_snapshot_end_read(void) {
+    g_atomic_int_inc(&read_epoch);
+}
+
+static void graphics_snapshot_build_hierarchy(PageSnapshot *snap) {
+    size_t len = snap->len_geometry;
+    size_t *offset = snap->child_offset;
+
+    memset(offset, 0, (len + 1) * sizeof( size_t ));
+
+    // count the children of each geometry
+    for (size_t i = 0; i < len; i++) {
+        IGeometry *geo = snap->geometry[i];
+        if (geo == NULL || geo->parent_id < 0 || (size_t) geo->parent_id >= len) {
+            continue;
+        }
+
+        offset[geo->parent_id + 1]++;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        offset[i + 1] += offset[i];
+    }
+
+    // offset[i] is used as the insert position of 
+    // geometry i, and restored after
+    for (size_t i = 0; i < len; i++) {
+        IGeometry *geo = snap->geometry[i];
+        if (geo == NULL || geo->parent_id < 0 || (size_t) geo->parent_id >= len) {
+            continue;
+        }
+
+        snap->child[offset[geo->parent_id]++] = i;
+    }
+
+    for (size_t i = len; i > 0; i--) {
+        offset[i] = offset[i - 1];
+    }
+
+    offset[0] = 0;
+
+    // partition the children by mask
+    for (size_t i = 0; i < len; i++) {
+        size_t n = offset[i];
+
+        for (size_t j = offset[i]; j < offset[i + 1]; j++) {
+            if (!snap->geometry[snap->child[j]]->mask_geo) {
+                snap->draw[n++] = snap->child[j];
+            }
+        }
+
+        snap->mask_offset[i] = n;
+
+        for (size_t j = offset[i]; j < offset[i + 1]; j++) {
+            if (snap->geometry[snap->child[j]]->mask_geo) {
+                snap->draw[n++] = snap->child[j];
+            }
+        }
+    }
+}
+
+static PageSnapshot *graphics_snapshot_new(IPage *page) {
+    PageSnapshot *snap = NEW_STRUCT(PageSnapshot);
+    Tracks *t = &page->tracks;
+    Tracks *snap_t = &snap->tracks;
+    size_t size = 0;
+
+    memset(snap, 0, sizeof( PageSnapshot ));
+    snap->temp_id = page->temp_id;
+    snap->len_geometry = page->len_geometry;
+    snap->max_keyframe = page->max_keyframe;
+    snap->serial = g_atomic_int_add(&next_serial, 1);
+    snap->geometry = NEW_ARRAY(page->len_geometry, IGeometry *);
+
+    for (int geo_id = 0; geo_id < page->len_geometry; geo_id++) {
+        if (page->geometry[geo_id] == NULL) {
+            continue;
+        }
+
+        size += geometry_geo_size(page->geometry[geo_id]);
+    }
+
+    // geometry is copied into one block
+    snap->memory = NEW_ARRAY(size, int8_t);
+    size = 0;
+
+    for (int geo_id = 0; geo_id < page->len_geometry; geo_id++) {
+        IGeometry *geo = page->geometry[geo_id];
+        snap->geometry[geo_id] = NULL;
+
+        if (geo == NULL) {
+            continue;
+        }
+
+        snap->geometry[geo_id] = (IGeometry *) &snap->memory[size];
+        memcpy(snap->geometry[geo_id], geo, geometry_geo_size(geo));
+        size += geometry_geo_size(geo);
+    }
+
+    snap->child_offset = NEW_ARRAY(page->len_geometry + 1, size_t);
+    snap->mask_offset = NEW_ARRAY(page->len_geometry, size_t);
+    snap->child = NEW_ARRAY(page->len_geometry, int);
+    snap->draw = NEW_ARRAY(page->len_geometry, int);
+    graphics_snapshot_build_hierarchy(snap);
+
+    if (!t->baked) {
+        return snap;
+    }
+
+    size_t num_keys = t->num_segments * GEO_FIELD_NUMBER;
+
+    snap_t->num_segments = t->num_segments;
+    snap_t->num_tracks = t->num_tracks;
+    snap_t->capacity = t->num_tracks;
+    snap_t->offset = NEW_ARRAY(num_keys + 1, size_t);
+    snap_t->start = NEW_ARRAY(t->num_tracks, float);
+    snap_t->delta = NEW_ARRAY(t->num_tracks, float);
+    snap_t->value = NEW_ARRAY(t->num_tracks, float);
+    snap_t->field = NEW_ARRAY(t->num_tracks, void *);
+    snap_t->version = NEW_ARRAY(t->num_tracks, unsigned int *);
+
+    memcpy(snap_t->offset, t->offset, (num_keys + 1) * sizeof( size_t ));
+    memcpy(snap_t->start, t->start, t->num_tracks * sizeof( float ));
+    memcpy(snap_t->delta, t->delta, t->num_tracks * sizeof( float ));
+
+    // move the fields from the page geometry to the copy
+    for (size_t i = 0; i < t->num_tracks; i++) {
+        int8_t *geo = (int8_t *) page->geometry[t->geo_id[i]];
+        int8_t *copy = (int8_t *) snap->geometry[t->geo_id[i]];
+
+        snap_t->field[i] = copy + ((int8_t *) t->field[i] - geo);
+        snap_t->version[i] = &snap->geometry[t->geo_id[i]]->version;
+
+        IGeometry *page_geo = page->geometry[t->geo_id[i]];
+        if (t->field[i] == &page_geo->parent_id || t->field[i] == &page_geo->mask_geo) {
+            snap->keyframed_hierarchy = 1;
+        }
+    }
+
+    snap_t->baked = 1;
+    return snap;
+}
+
+static void graphics_snapshot_free(PageSnapshot *snap) {
+    graphics_tracks_free(&snap->tracks);
+    free(snap->child_offset);
+    free(snap->mask_offset);
+    free(snap->child);
+    free(snap->draw);
+    free(snap->geometry);
+    free(snap->memory);
+    free(snap);
+}
+
+/*
+ * A snapshot retired at an even epoch was not visible
+ * to a read in progress, a snapshot retired at an odd
+ * epoch is released when that read ends.
+ */
+static unsigned char graphics_snapshot_released(PageSnapshot *snap) {
+    unsigned int epoch = g_atomic_int_get(&read_epoch);
+    unsigned int release = snap->retire_epoch + (snap->retire_epoch & 1);
+
+    return (int) (epoch - release) >= 0;
+}
+
+static void graphics_page_reclaim(IPage *page) {
+    PageSnapshot **prev = &page->retired;
+
+    while (*prev != NULL) {
+        PageSnapshot *snap = *prev;
+
+        if (!graphics_snapshot_released(snap)) {
+            prev = &snap->next;
+            continue;
+        }
+
+        *prev = snap->next;
+        graphics_snapshot_free(snap);
+    }
+}
+
+/*
+ * Publish the current state of the page to the
+ * render thread, requires the page lock.
+ */
+void graphics_page_publish(IPage *page) {
+    PageSnapshot *snap = graphics_snapshot_new(page);
+    PageSnapshot *old = g_atomic_pointer_exchange(&page->snapshot, snap);
+
+    if (old != NULL) {
+        old->retire_epoch = g_atomic_int_get(&read_epoch);
+        old->next = page->retired;
+        page->retired = old;
+    }
+
+    graphics_page_reclaim(page);
+}
+
+/*
+ * Current snapshot of the page, or NULL if the page
+ * has not been published. Only valid until the next
+ * call to graphics_snapshot_end_read.
+ */
+PageSnapshot *graphics_page_snapshot(IPage *page) {
+    return g_atomic_pointer_get(&page->snapshot);
+}
+
+void graphics_snapshot_interpolate(PageSnapshot *snap, int index, int width) {
+    graphics_tracks_interpolate(&snap->tracks, index, width);
+
+    if (snap->keyframed_hierarchy) {
+        graphics_snapshot_build_hierarchy(snap);
+    }
+}
+
+void graphics_page_free_snapshots(IPage *page) {
+    PageSnapshot *snap = g_atomic_pointer_exchange(&page->snapshot, NULL);
+    if (snap != NULL) {
+        graphics_snapshot_free(snap);
+    }
+
+    while (page->retired != NULL) {
+        snap = page->retired;
+        page->retired = snap->next;
+        graphics_snapshot_free(snap);
+    }
+}
@@ -0,0 +1,242 @@
+/*
+ * gr_track.c
+ *
+ * Interpolation tracks for the keyframes of a page.
+ *
+ * Each node of the keyframe graph in keyframe s is
+ * baked into a track of keyframe segment s, which
+ * stores the start value, the change in value to
+ * keyframe s + 1 and the geometry field to write.
+ * Tracks are grouped by segment and field type,
+ * so interpolating a frame is a lerp over a
+ * contiguous range followed by a store per field
+ * type, without walking the graph or going through
+ * the string based geometry setters.
+ *
+ *      void graphics_page_bake_tracks(IPage *page);
+ *      void graphics_page_update_tracks(IPage *page);
+ *      void graphics_tracks_interpolate(Tracks *t, int index, int width);
+ *
+ * graphics_page_bake_tracks builds the tracks from the
+ * graph, graphics_page_update_tracks copies the node
+ * values into the tracks after the graph is evaluated,
+ * baking the tracks if the graph has changed.
+ *
+ */
+
+#include "graphics_internal.h"
+
+static void graphics_tracks_reserve(Tracks *t, size_t capacity) {
+    if (t->capacity >= capacity) {
+        return;
+    }
+
+    free(t->start);
+    free(t->delta);
+    free(t->value);
+    free(t->field);
+    free(t->version);
+    free(t->node);
+    free(t->next_node);
+    free(t->geo_id);
+
+    t->capacity = capacity;
+    t->start = NEW_ARRAY(capacity, float);
+    t->delta = NEW_ARRAY(capacity, float);
+    t->value = NEW_ARRAY(capacity, float);
+    t->field = NEW_ARRAY(capacity, void *);
+    t->version = NEW_ARRAY(capacity, unsigned int *);
+    t->node = NEW_ARRAY(capacity, size_t);
+    t->next_node = NEW_ARRAY(capacity, size_t);
+    t->geo_id = NEW_ARRAY(capacity, int);
+}
+
+void graphics_page_bake_tracks(IPage *page) {
+    Tracks *t = &page->tracks;
+    Graph *g = &page->keyframe_graph;
+    size_t num_keys = page->max_keyframe * GEO_FIELD_NUMBER;
+    size_t n = 0;
+
+    graphics_tracks_reserve(t, g->num_nodes);
+
+    free(t->offset);
+    t->offset = NEW_ARRAY(num_keys + 1, size_t);
+    t->num_segments = page->max_keyframe;
+
+    // nodes are collected in graph order with a key of
+    // segment and field type, then sorted by key
+    size_t *key = NEW_ARRAY(g->num_nodes, size_t);
+    void **field = NEW_ARRAY(g->num_nodes, void *);
+    size_t *node = NEW_ARRAY(g->num_nodes, size_t);
+    size_t *next_node = NEW_ARRAY(g->num_nodes, size_t);
+    int *geo_id = NEW_ARRAY(g->num_nodes, int);
+
+    memset(t->offset, 0, (num_keys + 1) * sizeof( size_t ));
+
+    for (int frame_num = 0; frame_num < page->max_keyframe; frame_num++) {
+        for (int id = 0; id < page->len_geometry; id++) {
+            IGeometry *geo = page->geometry[id];
+            if (geo == NULL) {
+                continue;
+            }
+
+            int k_index = frame_num * page->len_geometry + id;
+            int k1_index = (frame_num + 1) * page->len_geometry + id;
+            for (GeometryAttr attr = 0; attr < GEO_NUMBER; attr++) {
+                size_t k_node = graphics_graph_node_id(g, k_index, attr);
+                if (k_node == GRAPH_NO_NODE || !g->node[k_node].evaluated) {
+                    continue;
+                }
+
+                GeometryField type = geometry_attr_field(geo, attr, &field[n]);
+                if (type == GEO_FIELD_NONE) {
+                    continue;
+                }
+
+                size_t k1_node = GRAPH_NO_NODE;
+                if (frame_num < page->max_keyframe - 1) {
+                    k1_node = graphics_graph_node_id(g, k1_index, attr);
+                }
+
+                key[n] = frame_num * GEO_FIELD_NUMBER + type;
+                node[n] = k_node;
+                next_node[n] = (k1_node == GRAPH_NO_NODE) ? k_node : k1_node;
+                geo_id[n] = id;
+                t->offset[key[n] + 1]++;
+                n++;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < num_keys; i++) {
+        t->offset[i + 1] += t->offset[i];
+    }
+
+    // offset[k] is used as the insert position of key k,
+    // and restored after
+    for (size_t i = 0; i < n; i++) {
+        size_t j = t->offset[key[i]]++;
+
+        t->field[j] = field[i];
+        t->version[j] = &page->geometry[geo_id[i]]->version;
+        t->node[j] = node[i];
+        t->next_node[j] = next_node[i];
+        t->geo_id[j] = geo_id[i];
+    }
+
+    for (size_t i = num_keys; i > 0; i--) {
+        t->offset[i] = t->offset[i - 1];
+    }
+
+    t->offset[0] = 0;
+    t->num_tracks = n;
+    t->baked = 1;
+
+    free(key);
+    free(field);
+    free(node);
+    free(next_node);
+    free(geo_id);
+
+    graphics_page_update_tracks(page);
+
+    if (LOG_KEYFRAMES) {
+        log_file(LogMessage, "Graphics", "Baked %lu tracks over %lu segments", t->num_tracks, t->num_segments);
+    }
+}
+
+void graphics_page_update_tracks(IPage *page) {
+    Tracks *t = &page->tracks;
+    Node *node = page->keyframe_graph.node;
+
+    if (!t->baked) {
+        graphics_page_bake_tracks(page);
+        return;
+    }
+
+    for (size_t i = 0; i < t->num_tracks; i++) {
+        t->start[i] = node[t->node[i]].value;
+        t->delta[i] = node[t->next_node[i]].value - node[t->node[i]].value;
+    }
+}
+
+void graphics_tracks_free(Tracks *t) {
+    free(t->offset);
+    free(t->start);
+    free(t->delta);
+    free(t->value);
+    free(t->field);
+    free(t->version);
+    free(t->node);
+    free(t->next_node);
+    free(t->geo_id);
+
+    memset(t, 0, sizeof( Tracks ));
+}
+
+void graphics_page_interpolate_geometry(IPage *page, int index, int width) {
+    graphics_tracks_interpolate(&page->tracks, index, width);
+}
+
+void graphics_tracks_interpolate(Tracks *t, int index, int width) {
+    int frame_start, frame_index;
+
+    if (!t->baked) {
+        return;
+    }
+
+    if (width == 0) {
+        log_file(LogWarn, "Graphics", "Interpolating over an interval of length 0");
+        return;
+    }
+
+    frame_start = index / width;
+    frame_index = index % width;
+
+    if (frame_start < 0 || frame_start >= t->num_segments) {
+        log_file(LogWarn, "Graphics", "Keyframe %d out of range", frame_start);
+        return;
+    }
+
+    size_t *offset = &t->offset[frame_start * GEO_FIELD_NUMBER];
+    float *value = t->value;
+    void **field = t->field;
+    unsigned int **version = t->version;
+
+    // matches graphics_keyframe_interpolate
+    for (size_t i = offset[0]; i < offset[GEO_FIELD_NUMBER]; i++) {
+        value[i] = t->delta[i] * frame_index / width + t->start[i];
+    }
+
+    for (size_t i = offset[GEO_FIELD_FLOAT]; i < offset[GEO_FIELD_FLOAT + 1]; i++) {
+        float v = value[i];
+        if (*(float *)field[i] != v) {
+            *(float *)field[i] = v;
+            (*version[i])++;
+        }
+    }
+
+    for (size_t i = offset[GEO_FIELD_INT]; i < offset[GEO_FIELD_INT + 1]; i++) {
+        int v = (int) value[i];
+        if (*(int *)field[i] != v) {
+            *(int *)field[i] = v;
+            (*version[i])++;
+        }
+    }
+
+    for (size_t i = offset[GEO_FIELD_ANGLE]; i < offset[GEO_FIELD_ANGLE + 1]; i++) {
+        float v = (int) value[i] * M_PI / 180;
+        if (*(float *)field[i] != v) {
+            *(float *)field[i] = v;
+            (*version[i])++;
+        }
+    }
+
+    for (size_t i = offset[GEO_FIELD_INT_FLOAT]; i < offset[GEO_FIELD_INT_FLOAT + 1]; i++) {
+        float v = (float) (int) value[i];
+        if (*(float *)field[i] != v) {
+            *(float *)field[i] = v;
+            (*version[i])++;
+        }
+    }
+}
@@ -21,6 +21,7 @@
 void         graphics_page_init_arena(IPage *page);
 void         graphics_init_page(IPage *, int temp_id, int num_geo, int max_keyframe);
 void         graphics_page_clear(IPage *);
+void         graphics_page_log_usage(IPage *);
 void         graphics_page_generate(IPage *);
 int          graphics_page_free_page(IPage *);
 
@@ -29,12 +30,24 @@ FrameType    graphics_keyframe_type(char *name);
 float       graphics_keyframe_interpolate(float v_start, float v_end, int index, int width);
 
 /* gr_graph.c */
-void          graphics_new_graph(Arena *a, Graph *g, size_t n);
+void          graphics_new_graph(Graph *g, size_t n);
+void          graphics_free_graph(Graph *g);
+size_t        graphics_graph_node_id(Graph *g, size_t index, GeometryAttr attr);
 Node          *graphics_graph_get_node(Graph *g, size_t index, GeometryAttr attr);
 void          graphics_graph_add_eval_node(Graph *g, size_t x, GeometryAttr attr, NodeEval f);
 void          graphics_graph_add_leaf_node(Graph *g, size_t x, GeometryAttr attr, float value);
 Edge          *graphics_graph_add_edge(Graph *g, size_t x, GeometryAttr x_attr, 
                                       size_t y, GeometryAttr y_attr);
+void          graphics_graph_compile(Graph *g);
 void          graphics_graph_evaluate_dag(Graph *g);
 
+/* gr_track.c */
+void          graphics_page_bake_tracks(IPage *page);
+void          graphics_page_update_tracks(IPage *page);
+void          graphics_tracks_interpolate(Tracks *t, int index, int width);
+void          graphics_tracks_free(Tracks *t);
+
+/* gr_snapshot.c */
+void          graphics_page_free_snapshots(IPage *page);
+
 #endif // !GRAPHICS_INTERNAL
@@ -4,14 +4,17 @@
  * Exposes the functions
  *
  *    int parser_tcp_start_server(char *addr, int port);
- *    void parser_read_socket(Engine *eng, int *page_num, int *action);
+ *    int parser_tcp_recieve_client(Client *client);
+ *    int parser_parse_graphic(Engine *eng, Client *client, PageStatus *status);
  *  
  * to the program. parser_tcp_start_server starts up
  * a tcp server for a given address and port. 
- * parser_read_socket listens to the tcp server for an 
- * incoming message with a timeout. If a message is recieved,
- * the message is parsed, updating the relevant geometry data
- * and the page_num and action passed to the function.
+ * parser_tcp_recieve_client reads the bytes available
+ * on a non-blocking client socket into the client buffer.
+ * parser_parse_graphic parses the next complete message 
+ * in the client buffer, in the text (v1.4) or binary (v2) 
+ * format, updating the relevant geometry data and the 
+ * page_num and action passed to the function.
  */
 
 #ifndef CHROMA_PARSER
@@ -22,6 +25,11 @@
 extern int parser_accept_conn(int server_socket);
 extern int parser_tcp_start_server(int port);
 extern int parser_tcp_start_client(char *addr, int port);
+extern int parser_tcp_set_nonblocking(int socket);
+
+extern Client *parser_new_client(int client_sock);
+extern void parser_free_client(Client *client);
+extern int parser_tcp_recieve_client(Client *client);
 
 extern int parser_parse_graphic(Engine *eng, Client *client, PageStatus *status);
 extern int parser_parse_hub(Engine *eng);
@@ -13,10 +13,17 @@
 #include "chroma-typedefs.h"
 #include "geometry.h"
 
-#define MAX_CONNECTIONS     10
+#define MAX_CONNECTIONS     128
+#define CLIENT_BUF_SIZE     KILOBYTES(64)
+#define MAX_CLIENT_BUF_SIZE MEGABYTES(16)
 #define LOG_PARSER          0
 #define LOG_TEMPLATE        0
 
+/* binary message format, see parser_recieve_binary.c */
+#define BINARY_MAGIC        0xC2
+#define BINARY_VERSION      2
+#define BINARY_HEADER_SIZE  16
+
 // ServerResponse MUST BE < 0 otherwise socket_client in parser will be incorrect
 typedef enum {
     SERVER_MESSAGE = -3,
@@ -45,8 +52,25 @@ typedef enum {
     BOOL,
 } Token;
 
+/* 
+ * Bytes of a buffer, ptr is not NUL terminated 
+ * unless stated.
+ */
+typedef struct {
+    char   *ptr;
+    size_t len;
+} StringView;
+
 ServerResponse  parser_tcp_recieve_message(int socket_client, char *buf);
-ServerResponse  parser_recieve_image(Engine *eng, GeometryImage *img);
+int             parser_client_next_message(Client *client);
+
+// parser_recieve_image.c
+ServerResponse  parser_fetch_image(Engine *eng, int image_id);
+void            parser_attach_image(Engine *eng, GeometryImage *img);
+
+// parser_recieve_binary.c
+int             parser_parse_binary_header(Client *client, PageStatus *status);
+int             parser_parse_binary_page(Client *client, IPage *page);
 
 // parser_http.c
 int             parser_update_template(Engine *eng, int page_num);
@@ -56,6 +80,10 @@ void            parser_incorrect_token(char tok1, char tok2, int buf_ptr, char *
 int             parser_get_char(int socket_client, int *buf_ptr, char *buf, char *c);
 void            parser_clean_buffer(int *buf_ptr, char *buf);
 ServerResponse  parser_get_message(int socket_client, int *buf_ptr, char *buf);
+int             parser_view_to_int(StringView view);
+double          parser_view_to_float(StringView view);
+uint16_t        parser_read_u16(const unsigned char *buf);
+uint32_t        parser_read_u32(const unsigned char *buf);
 
 
 #endif // !PARSER_INTERNAL
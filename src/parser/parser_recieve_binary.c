@@ -0,0 +1,250 @@
+/*
+ * parser_recieve_binary.c
+ *
+ * Parse the binary (v2) graphics messages from
+ * Chroma-Viz. The version is negotiated by the
+ * first byte of each message, a text (v1.4)
+ * message starts with "version=", a binary message
+ * starts with BINARY_MAGIC, so a client can send
+ * either format.
+ *
+ * A binary message is length prefixed, so it is
+ * framed without searching for END_OF_MESSAGE, and
+ * attrs are GeometryAttr ids with native values,
+ * so no strings are parsed. Integers and floats
+ * are little endian, and values are not aligned.
+ *
+ * Header, BINARY_HEADER_SIZE bytes
+ *
+ *      0   u8      BINARY_MAGIC
+ *      1   u8      major version, BINARY_VERSION
+ *      2   u8      minor version
+ *      3   u8      action
+ *      4   u32     length of the message, including the header
+ *      8   i32     template id
+ *      12  u16     layer
+ *      14  u16     number of geo blocks
+ *
+ * Geo block, a batch of attrs of a geometry
+ *
+ *      0   u16     geo num
+ *      2   u16     number of attrs
+ *      4           attrs
+ *
+ * Attr
+ *
+ *      0   u8      GeometryAttr
+ *      1   u8      BinaryType of the value
+ *      2           value
+ *
+ * Values
+ *
+ *      BINARY_FLOAT    f32
+ *      BINARY_INT      i32
+ *      BINARY_STRING   u16 length, the string, '\0'
+ *      BINARY_POINT    u16 index, f32 x, f32 y
+ *
+ */
+
+#include "chroma-typedefs.h"
+#include "graphics.h"
+#include "log.h"
+#include "parser_internal.h"
+
+#include <string.h>
+
+typedef enum {
+    BINARY_FLOAT,
+    BINARY_INT,
+    BINARY_STRING,
+    BINARY_POINT,
+} BinaryType;
+
+/*
+ * Next len bytes of the message, or NULL if the
+ * message is shorter than len.
+ */
+static unsigned char *parser_binary_read(Client *client, size_t len) {
+    if (client->msg_len - client->msg_ptr < len) {
+        log_file(LogWarn, "Parser", "Binary message ended early");
+        return NULL;
+    }
+
+    unsigned char *buf = (unsigned char *) &client->msg[client->msg_ptr];
+    client->msg_ptr += len;
+    return buf;
+}
+
+static float parser_binary_float(const unsigned char *buf) {
+    uint32_t bits = parser_read_u32(buf);
+    float value;
+
+    memcpy(&value, &bits, sizeof value);
+    return value;
+}
+
+int parser_parse_binary_header(Client *client, PageStatus *status) {
+    unsigned char *header = parser_binary_read(client, BINARY_HEADER_SIZE);
+    if (header == NULL) {
+        return -1;
+    }
+
+    if (header[0] != BINARY_MAGIC || header[1] != BINARY_VERSION) {
+        log_file(LogError, "Parser", "Incorrect encoding version v%d.%d, expected v%d",
+                 header[1], header[2], BINARY_VERSION);
+        return -1;
+    }
+
+    if (parser_read_u32(&header[4]) != client->msg_len) {
+        log_file(LogError, "Parser", "Binary message length %u, expected %lu",
+                 parser_read_u32(&header[4]), client->msg_len);
+        return -1;
+    }
+
+    status->action = header[3];
+    status->temp_id = (int32_t) parser_read_u32(&header[8]);
+    status->layer = parser_read_u16(&header[12]);
+
+    if (LOG_PARSER) {
+        log_file(LogMessage, "Parser", "Message v%d.%d", header[1], header[2]);
+        log_file(LogMessage, "Parser", "Layer %d, Action %d, Template id %d",
+                 status->layer, status->action, status->temp_id);
+    }
+
+    return 0;
+}
+
+/*
+ * Set attr of the geometry from the next value
+ * of the message. The numeric attrs are keyframe
+ * values, as in parser_parse_page.
+ */
+static int parser_binary_attr(Client *client, IPage *page, int geo_num, GeometryAttr attr, BinaryType type) {
+    unsigned char *buf;
+    uint16_t len;
+    int valid = WITHIN((int) attr, 0, GEO_NUM - 1) && attr != GEO_NUMBER;
+
+    if (!valid) {
+        log_file(LogWarn, "Parser", "Unknown geometry attr %d", attr);
+    }
+
+    switch (type) {
+        case BINARY_FLOAT:
+            if ((buf = parser_binary_read(client, 4)) == NULL) {
+                return -1;
+            }
+
+            if (!valid) {
+                break;
+            } else if (attr < GEO_NUMBER) {
+                graphics_graph_update_leaf(&page->keyframe_graph, geo_num, attr, parser_binary_float(buf));
+            } else {
+                geometry_set_float_attr(page->geometry[geo_num], attr, parser_binary_float(buf));
+            }
+
+            break;
+
+        case BINARY_INT:
+            if ((buf = parser_binary_read(client, 4)) == NULL) {
+                return -1;
+            }
+
+            if (!valid) {
+                break;
+            } else if (attr < GEO_NUMBER) {
+                graphics_graph_update_leaf(&page->keyframe_graph, geo_num, attr, (int32_t) parser_read_u32(buf));
+            } else {
+                geometry_set_int_attr(page->geometry[geo_num], attr, (int32_t) parser_read_u32(buf));
+            }
+
+            break;
+
+        case BINARY_STRING:
+            if ((buf = parser_binary_read(client, 2)) == NULL) {
+                return -1;
+            }
+
+            len = parser_read_u16(buf);
+            if ((buf = parser_binary_read(client, len + 1)) == NULL) {
+                return -1;
+            }
+
+            if (buf[len] != '\0') {
+                log_file(LogWarn, "Parser", "Binary string is not NUL terminated");
+                return -1;
+            }
+
+            if (!valid) {
+                break;
+            } else if (attr < GEO_NUMBER) {
+                graphics_graph_update_leaf(&page->keyframe_graph, geo_num, attr,
+                                           parser_view_to_float((StringView){(char *) buf, len}));
+            } else {
+                geometry_set_str_attr(page->geometry[geo_num], attr, (char *) buf);
+            }
+
+            break;
+
+        case BINARY_POINT:
+            if ((buf = parser_binary_read(client, 10)) == NULL) {
+                return -1;
+            }
+
+            if (attr != GEO_POINT) {
+                log_file(LogWarn, "Parser", "Point value for attr %d", attr);
+                break;
+            }
+
+            vec2 point = {parser_binary_float(&buf[2]), parser_binary_float(&buf[6])};
+            geometry_set_point_attr(page->geometry[geo_num], point, parser_read_u16(buf));
+            break;
+
+        default:
+            log_file(LogError, "Parser", "Unknown binary value type %d", type);
+            return -1;
+    }
+
+    if (LOG_PARSER) {
+        log_file(LogMessage, "Parser", "\tgeo %d: attr %d, type %d", geo_num, attr, type);
+    }
+
+    return 0;
+}
+
+int parser_parse_binary_page(Client *client, IPage *page) {
+    unsigned char *header = (unsigned char *) client->msg;
+    int num_blocks = parser_read_u16(&header[14]);
+
+    for (int i = 0; i < num_blocks; i++) {
+        unsigned char *block = parser_binary_read(client, 4);
+        if (block == NULL) {
+            return -1;
+        }
+
+        int geo_num = parser_read_u16(&block[0]);
+        int num_attrs = parser_read_u16(&block[2]);
+
+        if (geo_num >= page->len_geometry || page->geometry[geo_num] == NULL) {
+            log_file(LogError, "Parser", "Geo num %d out of range", geo_num);
+            return -1;
+        }
+
+        for (int j = 0; j < num_attrs; j++) {
+            unsigned char *attr = parser_binary_read(client, 2);
+            if (attr == NULL) {
+                return -1;
+            }
+
+            if (parser_binary_attr(client, page, geo_num, attr[0], attr[1]) < 0) {
+                return -1;
+            }
+        }
+    }
+
+    if (client->msg_ptr != client->msg_len) {
+        log_file(LogWarn, "Parser", "Binary message has %lu bytes after the last geo",
+                 client->msg_len - client->msg_ptr);
+    }
+
+    return 0;
+}
@@ -18,28 +18,31 @@
 
 int     parser_parse_page(Client *client, IPage *page);
 int     parser_parse_header(Client *client, PageStatus *status);
-int     parser_get_token(Client *client, char *value, Token *t);
+int     parser_get_pair(Client *client, StringView *attr, StringView *value);
+
+static void parser_page_images(Engine *eng, IPage *page);
 
 /*
- * Check clients array for messages, first checking the current client;
- *
- * If we have an open connection, listen for a message, 
- *    - If we recieve a graphics request, parse the page,
- *    - If the listen times out, move on to the next client,
- *    - If the client closes the connection, close on our end.
+ * Parse the next message in the client buffer, 
+ * a text message ends with END_OF_MESSAGE, and a 
+ * binary message (see parser_recieve_binary.c)
+ * starts with BINARY_MAGIC and its length.
  *
+ * Returns 1 if a message was parsed, 0 if the 
+ * buffer doesn't hold a complete message, and -1 
+ * if the client should be closed.
  */
 int parser_parse_graphic(Engine *eng, Client *client, PageStatus *status) {
-    ServerResponse res;
-
-    // wait for message
-    res = parser_get_message(client->client_sock, &client->buf_ptr, client->buf);
-    if (res == SERVER_CLOSE) {
-        return -1;
+    int res = parser_client_next_message(client);
+    if (res <= 0) {
+        return res;
     }
 
+    int binary = (unsigned char) client->msg[0] == BINARY_MAGIC;
+
     int start = clock();
-    if (parser_parse_header(client, status) < 0) {
+    res = binary ? parser_parse_binary_header(client, status) : parser_parse_header(client, status);
+    if (res < 0) {
         log_file(LogMessage, "Parser", "Buffer: ", client->buf);
         return -1;
     }
@@ -52,74 +55,109 @@ int parser_parse_graphic(Engine *eng, Client *client, PageStatus *status) {
         }
 
         status->action = BLANK;
-        char attr[PARSE_BUF_SIZE];
-        Token t = NONE;
-        while (t != EOM) {
-            if (parser_get_token(client, attr, &t) < 0) {
-                log_file(LogWarn, "Parser", "Missing EOM tag");
-                break;
-            }
-        };
 
         int end = clock();
         log_file(LogMessage, "Graphics", "Update template in %f ms", ((double) (end - start) * 1000) / CLOCKS_PER_SEC);
 
-        return 0;
+        return 1;
     }
 
     IPage *page = graphics_hub_get_page(&eng->hub, status->temp_id);
     if (page == NULL) {
-        // invalid page, reset globals and clear remaining message
+        // invalid page, reset globals, the rest of the
+        // message is skipped by the next parse
         status->temp_id = -1;
         status->action = BLANK;
         status->layer = 0;
 
-        char attr[PARSE_BUF_SIZE];
-        Token t = NONE;
-        while (t != EOM) {
-            if (parser_get_token(client, attr, &t) < 0) {
-                log_file(LogWarn, "Parser", "Missing EOM tag");
-                break;
-            }
-        };
-
         return -1;
     }
 
     g_mutex_lock(&page->lock);
     // Read new page values
 
-    if (parser_parse_page(client, page) < 0) {
+    res = binary ? parser_parse_binary_page(client, page) : parser_parse_page(client, page);
+    if (res < 0) {
         g_mutex_unlock(&page->lock);
         return -1;
     }
 
+    parser_page_images(eng, page);
+
+    int end = clock();
+    log_file(LogMessage, "Graphics", "Parsed Page in %f ms", ((double) (end - start) * 1000) / CLOCKS_PER_SEC);
+
+    // the keyframes are calculated once per frame for 
+    // all the messages to the page, see graphics_hub_flush_pages
+    graphics_page_mark_pending(page);
+    g_mutex_unlock(&page->lock);
+
+    return 1;
+}
+
+static unsigned char parser_is_image(IGeometry *geo) {
+    return geo != NULL && geo->geo_type == IMAGE 
+        && WITHIN(((GeometryImage *)geo)->image_id, 0, MAX_ASSETS - 1);
+}
+
+/*
+ * Request the images of the page which are not loaded,
+ * and point the image geometry at the assets. Called 
+ * with the page lock held, the lock is released while
+ * waiting on the hub.
+ */
+static void parser_page_images(Engine *eng, IPage *page) {
+    int num_images = 0;
+
     for (int i = 0; i < page->len_geometry; i++) {
-        IGeometry *geo = page->geometry[i];
-        if (geo == NULL) {
-            continue;
-        }
+        num_images += parser_is_image(page->geometry[i]);
+    }
 
-        if (geo->geo_type != IMAGE) {
-            continue;
+    if (num_images == 0) {
+        return;
+    }
+
+    int *image_id = NEW_ARRAY(num_images, int);
+    num_images = 0;
+
+    for (int i = 0; i < page->len_geometry; i++) {
+        if (parser_is_image(page->geometry[i])) {
+            image_id[num_images++] = ((GeometryImage *)page->geometry[i])->image_id;
         }
+    }
+
+    g_mutex_unlock(&page->lock);
 
-        if (parser_recieve_image(eng, (GeometryImage *)geo) != SERVER_MESSAGE) {
+    for (int i = 0; i < num_images; i++) {
+        if (parser_fetch_image(eng, image_id[i]) != SERVER_MESSAGE) {
             log_file(LogWarn, "Parser", "Error receiving image from chroma hub");
         }
     }
 
-    int end = clock();
-    log_file(LogMessage, "Graphics", "Parsed Page in %f ms", ((double) (end - start) * 1000) / CLOCKS_PER_SEC);
+    g_mutex_lock(&page->lock);
+    free(image_id);
 
-    start = clock();
-    graphics_page_calculate_keyframes(page);
-    end = clock();
+    // the page may have changed while unlocked
+    for (int i = 0; i < page->len_geometry; i++) {
+        if (parser_is_image(page->geometry[i])) {
+            parser_attach_image(eng, (GeometryImage *)page->geometry[i]);
+        }
+    }
+}
 
-    log_file(LogMessage, "Graphics", "Calculated keyframes in %f ms", ((double) (end - start) * 1000) / CLOCKS_PER_SEC);
-    g_mutex_unlock(&page->lock);
+static Token parser_header_token(StringView name) {
+    switch (name.len) {
+        case 4:
+            return (memcmp(name.ptr, "temp", 4) == 0) ? TEMPID : ATTR;
+        case 5:
+            return (memcmp(name.ptr, "layer", 5) == 0) ? LAYER : ATTR;
+        case 6:
+            return (memcmp(name.ptr, "action", 6) == 0) ? ACTION : ATTR;
+        case 7:
+            return (memcmp(name.ptr, "version", 7) == 0) ? VERSION : ATTR;
+    }
 
-    return 0;
+    return ATTR;
 }
 
 /*
@@ -131,25 +169,21 @@ int parser_parse_header(Client *client, PageStatus *status) {
     int parsed_action = 0;
     int parsed_temp_id = 0;
 
-    Token tok_attr, tok_value;
+    StringView attr, value;
     int v_m, v_n;
-    char attr[PARSE_BUF_SIZE];
-    char value[PARSE_BUF_SIZE];
 
     while (1) {
-        if (parser_get_token(client, attr, &tok_attr) < 0) {
-            log_file(LogError, "Parser", "Get token %s %d", __FILE__, __LINE__);
-            return -1;
-        }
-
-        if (parser_get_token(client, value, &tok_value) < 0) {
-            log_file(LogError, "Parser", "Get token %s %d", __FILE__, __LINE__);
+        if (parser_get_pair(client, &attr, &value) <= 0) {
+            log_file(LogError, "Parser", "Didn't find header tokens");
             return -1;
         }
 
-        switch (tok_attr) {
+        switch (parser_header_token(attr)) {
             case VERSION:
-                sscanf(value, "%d,%d", &v_m, &v_n);
+                if (sscanf(value.ptr, "%d,%d", &v_m, &v_n) != 2) {
+                    v_m = v_n = 0;
+                }
+
                 parsed_version = 1;
                 
                 if (v_m != 1 || v_n != 4) {
@@ -163,7 +197,7 @@ int parser_parse_header(Client *client, PageStatus *status) {
                 break;
 
             case LAYER:
-                sscanf(value, "%d", &status->layer);
+                status->layer = parser_view_to_int(value);
                 parsed_length = 1;
 
                 if (LOG_PARSER) {
@@ -172,7 +206,7 @@ int parser_parse_header(Client *client, PageStatus *status) {
                 break;
 
             case ACTION:
-                sscanf(value, "%d", (int *)&status->action);
+                status->action = parser_view_to_int(value);
                 parsed_action = 1;
 
                 if (LOG_PARSER) {
@@ -181,7 +215,7 @@ int parser_parse_header(Client *client, PageStatus *status) {
                 break;
 
             case TEMPID:
-                sscanf(value, "%d", &status->temp_id);
+                status->temp_id = parser_view_to_int(value);
                 parsed_temp_id = 1;
 
                 if (LOG_PARSER) {
@@ -198,115 +232,78 @@ int parser_parse_header(Client *client, PageStatus *status) {
             return 0;
         }
     }
-
-    log_file(LogError, "Parser", "Didn't find header tokens");
-    return -1;
 }
 
 int parser_parse_page(Client *client, IPage *page) {
-    char attr[PARSE_BUF_SIZE], value[PARSE_BUF_SIZE];
-    Token tok;
-    IGeometry *geo;
+    StringView attr, value;
     int geo_num = -1;
+    int res;
 
-    while (1) {
-        if (parser_get_token(client, attr, &tok) < 0) {
-            log_file(LogError, "Parser", "Get token %s %d", __FILE__, __LINE__);
-            return -1;
-        }
-
-        if (tok == EOM) {
-            return 0;
-        } else if (tok != ATTR) {
-            log_file(LogWarn, "Parser", "Unexpected token %d, expected %d", tok, ATTR);
-        }
-        
-        if (parser_get_token(client, value, &tok) < 0) {
-            log_file(LogError, "Parser", "Get token %s %d", __FILE__, __LINE__);
-            return -1;
-        }
-
-        if (tok == EOM) {
-            log_file(LogWarn, "Parser", "Parsed attr without a value");
-        } else if (tok != VALUE) {
-            log_file(LogWarn, "Parser", "Unexpected token %d, expected %d", tok, VALUE);
-        }
-
-        if (strncmp(attr, "geo_num", 7) == 0) {
-            geo_num = atoi(value);
+    while ((res = parser_get_pair(client, &attr, &value)) > 0) {
+        if (attr.len == 7 && memcmp(attr.ptr, "geo_num", 7) == 0) {
+            geo_num = parser_view_to_int(value);
             continue;
         }
 
-        if (geo_num == -1) {
+        if (geo_num < 0 || geo_num >= page->len_geometry) {
             log_file(LogError, "Parser", "Didn't find a geo num");
             return -1;
         }
 
-        GeometryAttr geo_attr = geometry_char_to_attr(attr);
-        geo = page->geometry[geo_num];
+        GeometryAttr geo_attr = geometry_name_to_attr(attr.ptr, attr.len);
 
-        if (geo_attr < GEO_NUMBER) {
-            graphics_graph_update_leaf(&page->keyframe_graph, geo_num, geo_attr, atof(value));
+        if (!WITHIN((int) geo_attr, 0, GEO_NUM - 1)) {
+            continue;
+        } else if (geo_attr < GEO_NUMBER) {
+            graphics_graph_update_leaf(&page->keyframe_graph, geo_num, geo_attr, parser_view_to_float(value));
         } else {
-            geometry_set_attr(geo, attr, value);
+            geometry_set_str_attr(page->geometry[geo_num], geo_attr, value.ptr);
         }
 
         if (LOG_PARSER) {
-            log_file(LogMessage, "Parser", "\tgeo %d: %s = %s", geo_num, attr, value);
+            log_file(LogMessage, "Parser", "\tgeo %d: %s = %s", geo_num, attr.ptr, value.ptr);
         }
     }
-}
 
-int parser_get_token(Client *client, char *value, Token *t) {
-    char c;
-    int i = 0;
-    memset(value, '\0', PARSE_BUF_SIZE);
-
-    // read chars until we get a '#', '=' or end of message
-    while (1) {
-        if (parser_get_char(client->client_sock, &client->buf_ptr, client->buf, &c) < 0) {
-            return -1;
-        }
+    return res;
+}
 
-        switch (c) {
-            case '=':
-                goto EQUAL;
-            case '#':
-                goto HASH;
-            case END_OF_MESSAGE:
-                *t = EOM;
-                return 0;
-        }
+/*
+ * Get the next attr=value# pair of the message. The 
+ * attr and value point into the client message, and 
+ * are NUL terminated in place of the '=' and '#'.
+ *
+ * Returns 1 for a pair, 0 at the end of the message
+ * and -1 if the rest of the message isn't a pair.
+ */
+int parser_get_pair(Client *client, StringView *attr, StringView *value) {
+    char *start = &client->msg[client->msg_ptr];
+    char *end = &client->msg[client->msg_len - 1];
 
-        if (i >= PARSE_BUF_SIZE) {
-            log_file(LogError, "Parser", "token buffer out of memory");
-            return -1;
-        }
+    if (start >= end) {
+        return 0;
+    }
 
-        value[i++] = c;
+    char *equal = memchr(start, '=', end - start);
+    if (equal == NULL) {
+        log_file(LogWarn, "Parser", "Parsed attr without a value");
+        return -1;
     }
 
-EQUAL:
-    // We found an attribute 
-    *t = ATTR;
-
-    // check if it part of the message header
-    if (strcmp(value, "version") == 0) {
-        *t = VERSION;
-    } else if (strcmp(value, "layer") == 0) {
-        *t = LAYER;
-    } else if (strcmp(value, "action") == 0) {
-        *t = ACTION;
-    } else if (strcmp(value, "temp") == 0) {
-        *t = TEMPID;
+    char *hash = memchr(equal + 1, '#', end - equal - 1);
+    if (hash == NULL) {
+        log_file(LogWarn, "Parser", "Missing end of value");
+        return -1;
     }
 
-    return 0;
+    *equal = '\0';
+    *hash = '\0';
 
-HASH:
-    // We found a value
-    *t = VALUE;
-    return 0;
+    attr->ptr = start;
+    attr->len = equal - start;
+    value->ptr = equal + 1;
+    value->len = hash - equal - 1;
 
+    client->msg_ptr = hash + 1 - client->msg;
+    return 1;
 }
-
@@ -14,8 +14,18 @@ void parser_parse_user_frame(JSONNode *frame, IPage *page);
 void parser_parse_bind_frame(JSONNode *frame, IPage *page);
 void parser_parse_set_frame(JSONNode *frame, IPage *page);
 
-// S -> {'num_temp': num, 'templates': [T]}
+static int parser_request_hub(Engine *eng);
+
 int parser_parse_hub(Engine *eng) {
+    g_mutex_lock(&eng->hub_lock);
+    int res = parser_request_hub(eng);
+    g_mutex_unlock(&eng->hub_lock);
+
+    return res;
+}
+
+// S -> {'num_temp': num, 'templates': [T]}
+static int parser_request_hub(Engine *eng) {
     char addr[PARSE_BUF_SIZE];
     log_file(LogMessage, "Parser", "Requesting Chroma Hub");
 
@@ -66,7 +76,12 @@ int parser_parse_hub(Engine *eng) {
     return 0;
 }
 
-int parser_update_template(Engine *eng, int temp_id) {
+/*
+ * Request a template from the hub, returns 1 if the 
+ * template was replaced, 0 if there was no template
+ * and -1 on an error.
+ */
+static int parser_request_template(Engine *eng, int temp_id) {
     char addr[PARSE_BUF_SIZE];
     memset(addr, '\0', sizeof addr);
     sprintf(addr, "%s/template/%d", eng->hub_addr, temp_id);
@@ -84,9 +99,47 @@ int parser_update_template(Engine *eng, int temp_id) {
 
     if (parser_parse_template(&template, &eng->hub) < 0) {
         return -1;
-    } 
+    }
 
     parser_clean_json();
+    return 1;
+}
+
+int parser_update_template(Engine *eng, int temp_id) {
+    g_mutex_lock(&eng->hub_lock);
+    int res = parser_request_template(eng, temp_id);
+    g_mutex_unlock(&eng->hub_lock);
+
+    if (res <= 0) {
+        return res;
+    }
+
+    // the template may reference changed assets, so
+    // images are requested again on the next graphics
+    IPage *page = graphics_hub_get_page(&eng->hub, temp_id);
+    if (page == NULL) {
+        return 0;
+    }
+
+    g_mutex_lock(&page->lock);
+    for (int i = 0; i < page->len_geometry; i++) {
+        IGeometry *geo = page->geometry[i];
+        if (geo == NULL || geo->geo_type != IMAGE) {
+            continue;
+        }
+
+        int image_id = ((GeometryImage *)geo)->image_id;
+        if (image_id < 0 || image_id >= MAX_ASSETS) {
+            continue;
+        }
+
+        // the old data is kept until the asset is replaced
+        g_mutex_lock(&eng->hub.img_lock);
+        eng->hub.img[image_id].version++;
+        g_mutex_unlock(&eng->hub.img_lock);
+    }
+    g_mutex_unlock(&page->lock);
+
     return 0;
 }
 
@@ -9,11 +9,16 @@
 #include <stddef.h>
 #include <string.h>
 
-static int socket_client = 0;
-static HTTPHeader *header;
-
-static char buf[PARSE_BUF_SIZE];
-static int buf_ptr = 0;
+/*
+ * State of one image request, passed to the png 
+ * reader, so requests don't share buffers.
+ */
+typedef struct {
+    int         socket_client;
+    HTTPHeader  *header;
+    int         buf_ptr;
+    char        buf[PARSE_BUF_SIZE];
+} ImageReader;
 
 union png_size {
     unsigned char bytes[4];
@@ -21,58 +26,113 @@ union png_size {
 };
 
 void free_row_pointers(int, png_bytep *);
-int parser_read_image(int *, int *, png_byte *, png_byte *, png_bytep **);
+int parser_read_image(ImageReader *, int *, int *, png_byte *, png_byte *, png_bytep **);
 void parser_read_png_data(png_structp png_ptr, png_bytep data, size_t length);
 
-ServerResponse parser_recieve_image(Engine *eng, GeometryImage *g_img) {
-    log_assert(g_img->image_id < MAX_ASSETS, "Parser", "Max assets exceeded");
-    Image *img = &eng->hub.img[g_img->image_id];
+static unsigned char parser_image_loaded(Engine *eng, int image_id) {
+    Image *img = &eng->hub.img[image_id];
+
+    g_mutex_lock(&eng->hub.img_lock);
+    unsigned char loaded = img->data != NULL && img->loaded == img->version;
+    g_mutex_unlock(&eng->hub.img_lock);
+
+    return loaded;
+}
+
+/*
+ * Request the image asset from the hub, unless the
+ * asset is loaded. Blocks on the hub, so must not 
+ * be called holding a page lock.
+ */
+ServerResponse parser_fetch_image(Engine *eng, int image_id) {
+    log_assert(image_id < MAX_ASSETS, "Parser", "Max assets exceeded");
+    Image *img = &eng->hub.img[image_id];
+
+    if (parser_image_loaded(eng, image_id)) {
+        return SERVER_MESSAGE;
+    }
 
-    if (img->data != NULL) {
-        g_img->data = img->data;
-        g_img->w = img->w;
-        g_img->h = img->h;
+    g_mutex_lock(&eng->hub_lock);
 
+    // another worker may have requested the asset
+    if (parser_image_loaded(eng, image_id)) {
+        g_mutex_unlock(&eng->hub_lock);
         return SERVER_MESSAGE;
     }
 
     char addr[PARSE_BUF_SIZE];
     memset(addr, '\0', sizeof addr);
-    sprintf(addr, "%s/asset/%d", eng->hub_addr, g_img->image_id);
+    sprintf(addr, "%s/asset/%d", eng->hub_addr, image_id);
 
-    log_file(LogMessage, "Parser", "Request image %d", g_img->image_id);
-    socket_client = eng->hub_socket;
-    parser_http_get(socket_client, addr);
+    log_file(LogMessage, "Parser", "Request image %d", image_id);
 
-    header = parser_http_new_header(socket_client);
-    parser_http_header(header, &buf_ptr, buf);
+    ImageReader *reader = NEW_STRUCT(ImageReader);
+    reader->socket_client = eng->hub_socket;
+    reader->buf_ptr = 0;
+    memset(reader->buf, '\0', sizeof reader->buf);
+
+    parser_http_get(reader->socket_client, addr);
+
+    reader->header = parser_http_new_header(reader->socket_client);
+    parser_http_header(reader->header, &reader->buf_ptr, reader->buf);
 
     png_byte color_type, bit_depth;
     png_bytep *row_pointers = NULL;
 
-    if (parser_read_image(&img->w, &img->h, &color_type, &bit_depth, &row_pointers) < 0) {
+    int w, h;
+    int res = parser_read_image(reader, &w, &h, &color_type, &bit_depth, &row_pointers);
+
+    parser_http_free_header(reader->header);
+    free(reader);
+    g_mutex_unlock(&eng->hub_lock);
+
+    if (res < 0) {
         //log_file(LogWarn, "GL Render", "Error reading png");
         return SERVER_TIMEOUT;
     }
 
     //log_file(LogMessage, "GL Render", "Color Type %d, Bit Depth %d", color_type, bit_depth);
-    img->data = ARENA_ARRAY(&eng->hub.arena, img->w * img->h * 4, unsigned char);
+    g_mutex_lock(&eng->hub.img_lock);
+
+    // the buffer of the old asset is reused if the size matches
+    if (img->data == NULL || img->w != w || img->h != h) {
+        free(img->data);
+        img->data = NEW_ARRAY(w * h * 4, unsigned char);
+        log_assert(img->data != NULL, "Parser", "Unable to allocate image");
+    }
+
+    img->w = w;
+    img->h = h;
 
     for (int y = 0; y < img->h; y++) {
         memcpy(&img->data[4 * img->w * y], row_pointers[img->h - y - 1], 4 * img->w * sizeof( unsigned char ));
     }
 
-    free_row_pointers(img->h, row_pointers);
-    parser_http_free_header(header);
+    img->version++;
+    img->loaded = img->version;
+    g_mutex_unlock(&eng->hub.img_lock);
+
+    free_row_pointers(h, row_pointers);
+    return SERVER_MESSAGE;
+}
+
+/*
+ * Point the geometry at the image asset, requires 
+ * the page lock of the geometry.
+ */
+void parser_attach_image(Engine *eng, GeometryImage *g_img) {
+    log_assert(g_img->image_id < MAX_ASSETS, "Parser", "Max assets exceeded");
+    Image *img = &eng->hub.img[g_img->image_id];
 
+    g_mutex_lock(&eng->hub.img_lock);
     g_img->data = img->data;
     g_img->w = img->w;
     g_img->h = img->h;
-
-    return SERVER_MESSAGE;
+    g_img->version = img->version;
+    g_mutex_unlock(&eng->hub.img_lock);
 }
 
-int parser_read_image(int *w, int *h, png_byte *color_type, 
+int parser_read_image(ImageReader *reader, int *w, int *h, png_byte *color_type, 
                       png_byte *bit_depth, png_bytep **row_pointers) {
     png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
     if (!png_ptr) {
@@ -93,7 +153,7 @@ int parser_read_image(int *w, int *h, png_byte *color_type,
         return -1;
     }
 
-    png_set_read_fn(png_ptr, NULL, parser_read_png_data);
+    png_set_read_fn(png_ptr, reader, parser_read_png_data);
     png_read_info(png_ptr, info_ptr);
 
     *w = png_get_image_width(png_ptr, info_ptr);
@@ -135,38 +195,30 @@ int parser_read_image(int *w, int *h, png_byte *color_type,
     return 0;
 }
 
-static ServerResponse parser_get_bytes() {
-    if (buf_ptr < PARSE_BUF_SIZE) {
-        return SERVER_MESSAGE;
-    }
-
-    parser_clean_buffer(&buf_ptr, buf);
-    return parser_tcp_recieve_message(socket_client, buf);
-}
-
 void parser_read_png_data(png_structp png_ptr, png_bytep data, size_t length) {
     if (png_ptr == NULL) {
         return;
     }
 
-    if (socket_client == 0) {
+    ImageReader *reader = png_get_io_ptr(png_ptr);
+    if (reader->socket_client == 0) {
         png_error(png_ptr, "Hub not connected");
     }
 
     int parser_length, len, idx = 0;
     while (length != 0) {
-        parser_length = parser_http_get_bytes(header, &buf_ptr, buf);
+        parser_length = parser_http_get_bytes(reader->header, &reader->buf_ptr, reader->buf);
         if (parser_length < 0) {
             log_file(LogWarn, "Parser", "Error receiving image from chroma hub");
             continue;
         }
 
         len = MIN(parser_length, length);
-        memcpy(&data[idx], &buf[buf_ptr], len);
+        memcpy(&data[idx], &reader->buf[reader->buf_ptr], len);
 
         idx += len;
-        buf_ptr += len;
-        header->read += len;
+        reader->buf_ptr += len;
+        reader->header->read += len;
         length -= len;
     }
 }
@@ -10,6 +10,8 @@
 #include "log.h"
 #include "parser_internal.h"
 #include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <netinet/in.h>
 #include <stddef.h>
 #include <unistd.h>
@@ -122,6 +124,230 @@ int parser_accept_conn(int server_socket) {
     return client_sock;
 }
 
+int parser_tcp_set_nonblocking(int socket) {
+    int flags = fcntl(socket, F_GETFL, 0);
+    if (flags < 0 || fcntl(socket, F_SETFL, flags | O_NONBLOCK) < 0) {
+        log_file(LogWarn, "Parser", "Unable to make socket %d non-blocking", socket);
+        return -1;
+    }
+
+    return 0;
+}
+
+Client *parser_new_client(int client_sock) {
+    Client *client = NEW_STRUCT(Client);
+    memset(client, 0, sizeof( Client ));
+
+    client->client_sock = client_sock;
+    client->status = (PageStatus){.temp_id = 0, .layer = 0, .action = BLANK};
+
+    client->buf_capacity = CLIENT_BUF_SIZE;
+    client->buf = NEW_ARRAY(client->buf_capacity, char);
+    log_assert(client->buf != NULL, "Parser", "Unable to allocate client buffer");
+
+    return client;
+}
+
+void parser_free_client(Client *client) {
+    free(client->buf);
+    free(client->msg_copy);
+    free(client);
+}
+
+/*
+ * Copy len bytes of the ring buffer, starting offset 
+ * bytes after the head, to dest.
+ */
+static void parser_client_copy(Client *client, char *dest, size_t offset, size_t len) {
+    size_t start = (client->buf_head + offset) & (client->buf_capacity - 1);
+    size_t first = MIN(len, client->buf_capacity - start);
+
+    memcpy(dest, &client->buf[start], first);
+    memcpy(&dest[first], client->buf, len - first);
+}
+
+/*
+ * Move the buffered bytes to a new ring buffer with 
+ * the given capacity, a power of 2.
+ */
+static void parser_client_resize(Client *client, size_t capacity) {
+    char *buf = NEW_ARRAY(capacity, char);
+    log_assert(buf != NULL, "Parser", "Unable to allocate client buffer");
+
+    parser_client_copy(client, buf, 0, client->buf_len);
+    free(client->buf);
+
+    client->buf = buf;
+    client->buf_capacity = capacity;
+    client->buf_head = 0;
+}
+
+/*
+ * Length of the binary message at the head of the 
+ * buffer, read from the header, or 0 if the buffer 
+ * doesn't hold the complete message. A length 
+ * shorter than the header is rejected by the parser.
+ */
+static size_t parser_client_find_binary(Client *client) {
+    unsigned char header[BINARY_HEADER_SIZE];
+
+    if (client->buf_len < BINARY_HEADER_SIZE) {
+        return 0;
+    }
+
+    parser_client_copy(client, (char *) header, 0, BINARY_HEADER_SIZE);
+    size_t len = MAX(parser_read_u32(&header[4]), BINARY_HEADER_SIZE);
+
+    return (client->buf_len >= len) ? len : 0;
+}
+
+/*
+ * Length of the first message in the buffer, including 
+ * the END_OF_MESSAGE, or 0 if the buffer doesn't hold a 
+ * complete message. The search continues from where 
+ * the last search stopped, so each byte is searched once.
+ */
+static size_t parser_client_find_message(Client *client) {
+    size_t mask = client->buf_capacity - 1;
+
+    if (client->buf_len > 0 && (unsigned char) client->buf[client->buf_head] == BINARY_MAGIC) {
+        return parser_client_find_binary(client);
+    }
+
+    while (client->scanned < client->buf_len) {
+        size_t start = (client->buf_head + client->scanned) & mask;
+        size_t len = MIN(client->buf_len - client->scanned, client->buf_capacity - start);
+
+        char *eom = memchr(&client->buf[start], END_OF_MESSAGE, len);
+        if (eom != NULL) {
+            client->scanned += eom - &client->buf[start];
+            return client->scanned + 1;
+        }
+
+        client->scanned += len;
+    }
+
+    return 0;
+}
+
+/*
+ * Release the message which was parsed, the ring 
+ * buffer returns to CLIENT_BUF_SIZE once empty.
+ */
+static void parser_client_drop_message(Client *client) {
+    if (client->msg_len == 0) {
+        return;
+    }
+
+    client->buf_head = (client->buf_head + client->msg_len) & (client->buf_capacity - 1);
+    client->buf_len -= client->msg_len;
+    client->scanned = 0;
+    client->msg_len = 0;
+    client->msg_ptr = 0;
+
+    if (client->buf_len == 0) {
+        client->buf_head = 0;
+
+        if (client->buf_capacity > CLIENT_BUF_SIZE) {
+            parser_client_resize(client, CLIENT_BUF_SIZE);
+        }
+    }
+}
+
+/*
+ * Release the last message and find the next message 
+ * in the client buffer. The message is contiguous in
+ * client->msg, a message which wraps around the end
+ * of the ring buffer is copied into client->msg_copy.
+ *
+ * Returns 1 if there is a message, 0 if the buffer 
+ * doesn't hold a complete message, and -1 if the 
+ * client closed the connection.
+ */
+int parser_client_next_message(Client *client) {
+    parser_client_drop_message(client);
+
+    if (client->buf_len > 0 && client->buf[client->buf_head] == END_OF_CONN) {
+        log_file(LogMessage, "Parser", "Client closed connection");
+        return -1;
+    }
+
+    size_t len = parser_client_find_message(client);
+    if (len == 0) {
+        return 0;
+    }
+
+    if (client->buf_head + len <= client->buf_capacity) {
+        client->msg = &client->buf[client->buf_head];
+    } else {
+        if (client->msg_copy_capacity < len) {
+            client->msg_copy_capacity = MAX(len, 2 * client->msg_copy_capacity);
+            client->msg_copy = realloc(client->msg_copy, client->msg_copy_capacity);
+            log_assert(client->msg_copy != NULL, "Parser", "Unable to allocate client message");
+        }
+
+        parser_client_copy(client, client->msg_copy, 0, len);
+        client->msg = client->msg_copy;
+    }
+
+    client->msg_len = len;
+    client->msg_ptr = 0;
+    return 1;
+}
+
+/*
+ * Read the bytes available on the (non-blocking) 
+ * client socket into the ring buffer of the client,
+ * messages are accumulated across reads. Reading 
+ * stops early if the buffer is full and holds a 
+ * complete message, the rest is read once the 
+ * buffered messages have been parsed.
+ *
+ * Returns -1 if the client closed the connection,
+ * the buffered messages can still be parsed.
+ */
+int parser_tcp_recieve_client(Client *client) {
+    while (1) {
+        if (client->buf_len == client->buf_capacity) {
+            if (parser_client_find_message(client) > 0) {
+                return 0;
+            }
+
+            if (client->buf_capacity >= MAX_CLIENT_BUF_SIZE) {
+                log_file(LogWarn, "Parser", "Client %d message too large", client->client_sock);
+                return -1;
+            }
+
+            parser_client_resize(client, 2 * client->buf_capacity);
+        }
+
+        size_t tail = (client->buf_head + client->buf_len) & (client->buf_capacity - 1);
+        size_t space = MIN(client->buf_capacity - client->buf_len, client->buf_capacity - tail);
+
+        ssize_t len = recv(client->client_sock, &client->buf[tail], space, 0);
+
+        if (len > 0) {
+            client->buf_len += len;
+            continue;
+        }
+
+        if (len == 0) {
+            return -1;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+
+        log_file(LogWarn, "Parser", "Error receiving message");
+        return -1;
+    }
+}
+
 ServerResponse parser_tcp_recieve_message(int client_sock, char *client_message) {
     char server_message[PARSE_BUF_SIZE];
 
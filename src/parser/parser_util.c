@@ -46,3 +46,84 @@ ServerResponse parser_get_message(int socket_client, int *buf_ptr, char *buf) {
     return parser_tcp_recieve_message(socket_client, buf);
 }
 
+
+int parser_view_to_int(StringView view) {
+    size_t i = 0;
+    int sign = 1;
+    int value = 0;
+
+    if (view.len > 0 && (view.ptr[0] == '-' || view.ptr[0] == '+')) {
+        sign = (view.ptr[0] == '-') ? -1 : 1;
+        i++;
+    }
+
+    for (; i < view.len && WITHIN(view.ptr[i], '0', '9'); i++) {
+        value = value * 10 + (view.ptr[i] - '0');
+    }
+
+    return sign * value;
+}
+
+/*
+ * Decimal numbers without an exponent, whose digits
+ * fit in a double, are converted exactly with one 
+ * multiply or divide. Other numbers are converted by 
+ * strtod, which needs the view to be NUL terminated.
+ */
+double parser_view_to_float(StringView view) {
+    static const double pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    uint64_t mantissa = 0;
+    int num_digits = 0;
+    int frac_digits = -1;
+    size_t i = 0;
+    double sign = 1.0;
+
+    if (view.len > 0 && (view.ptr[0] == '-' || view.ptr[0] == '+')) {
+        sign = (view.ptr[0] == '-') ? -1.0 : 1.0;
+        i++;
+    }
+
+    for (; i < view.len; i++) {
+        char c = view.ptr[i];
+
+        if (c == '.' && frac_digits < 0) {
+            frac_digits = 0;
+            continue;
+        }
+
+        if (!WITHIN(c, '0', '9') || num_digits >= 19) {
+            return strtod(view.ptr, NULL);
+        }
+
+        mantissa = mantissa * 10 + (c - '0');
+        num_digits++;
+        frac_digits += (frac_digits >= 0);
+    }
+
+    if (num_digits == 0 || mantissa > ((uint64_t) 1 << 53) || frac_digits > 22) {
+        return strtod(view.ptr, NULL);
+    }
+
+    double value = (double) mantissa;
+    if (frac_digits > 0) {
+        value /= pow10[frac_digits];
+    }
+
+    return sign * value;
+}
+
+/*
+ * Read the little endian integers of the binary 
+ * message format, buf doesn't need to be aligned.
+ */
+uint16_t parser_read_u16(const unsigned char *buf) {
+    return (uint16_t) (buf[0] | (buf[1] << 8));
+}
+
+uint32_t parser_read_u32(const unsigned char *buf) {
+    return (uint32_t) buf[0] | ((uint32_t) buf[1] << 8) | ((uint32_t) buf[2] << 16) | ((uint32_t) buf[3] << 24);
+}
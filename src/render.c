@@ -8,7 +8,20 @@
 #include "gl_render.h"
 #include "log.h"
 
+#include <errno.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
+#include <unistd.h>
+
+#define SERVER_WORKERS        4
+#define SERVER_MAX_EVENTS     64
+#define SERVER_FLUSH_US       (G_USEC_PER_SEC / CHROMA_FRAMERATE)
+
+typedef struct {
+    size_t      count;
+    size_t      capacity;
+    PageStatus  *items;
+} StatusQueue;
 
 Engine engine = {
     .render_perf = 0,
@@ -20,6 +33,13 @@ Config config = {
 };
 
 static GMutex lock;
+static int epoll_fd = -1;
+
+// layer actions recieved since the last flush, see chroma_flush_updates
+static GMutex queue_lock;
+static StatusQueue layer_queue[CHROMA_LAYERS];
+// swapped with layer_queue by the flush, only used by the server thread
+static StatusQueue flush_queue[CHROMA_LAYERS];
 unsigned char active = 0;
 
 static void chroma_close_renderer(GtkWidget *widget, gpointer data) {
@@ -31,30 +51,104 @@ static void chroma_close_renderer(GtkWidget *widget, gpointer data) {
     g_mutex_unlock(&lock);
 }
 
-static void *chroma_handle_conn(void *data) {
-    PageStatus status = (PageStatus){.temp_id = 0, .layer = 0, .action = BLANK};
-    Client client = {
-        .client_sock = *(int *)(data),
-        .buf_ptr = 0,
-    };
-    int exit = 0;
+/*
+ * Move the layer of the status to the page and 
+ * action of the status, called with gl_lock held.
+ */
+static void chroma_update_layer(PageStatus status) {
+    IPage *page = graphics_hub_get_page(&engine.hub, status.temp_id);
+    if (status.action == ANIMATE_ON || status.temp_id != page_num[status.layer]) {
+        frame_num[status.layer] = 1;
+    } else if (status.action == CONTINUE && page != NULL) {
+        frame_num[status.layer] = MIN(frame_num[status.layer] + 1, page->max_keyframe - 1);
+    } else if (status.action == ANIMATE_OFF && page != NULL) {
+        frame_num[status.layer] = page->max_keyframe - 1;
+    }
 
-    memset(&client.buf, '\0', sizeof client.buf);
+    page_num[status.layer]   = status.temp_id;
+    action[status.layer]     = status.action;
+    frame_time[status.layer] = 0.0;
+}
 
-    while (!exit) {
-        g_mutex_lock(&lock);
-        if (!active) {
-            log_file(LogMessage, "Engine", "Engine is not active, closing client %d handler", client.client_sock);
-            g_mutex_unlock(&lock);
-            exit = 1;
-            continue;
-        }
-        g_mutex_unlock(&lock);
+static void chroma_queue_update(PageStatus status) {
+    if (status.layer < 0 || status.layer >= CHROMA_LAYERS) {
+        log_file(LogWarn, "Engine", "Layer %d out of range", status.layer);
+        return;
+    }
 
-        if (parser_parse_graphic(&engine, &client, &status) < 0) {
-            exit = 1;
+    g_mutex_lock(&queue_lock);
+    DA_APPEND(&layer_queue[status.layer], status);
+    g_mutex_unlock(&queue_lock);
+}
+
+/*
+ * Apply the updates recieved since the last flush, 
+ * run once per frame by the server thread. The 
+ * attrs of a page are written to the keyframe graph 
+ * as each message is parsed, so repeated writes to 
+ * an attr are coalesced, and the keyframes of each 
+ * updated page are calculated once. The queued 
+ * layer actions are swapped out first, so every 
+ * action applied has its page published, and then
+ * applied in order.
+ */
+static void chroma_flush_updates(void) {
+    g_mutex_lock(&queue_lock);
+    for (int layer = 0; layer < CHROMA_LAYERS; layer++) {
+        StatusQueue queue = layer_queue[layer];
+        layer_queue[layer] = flush_queue[layer];
+        flush_queue[layer] = queue;
+    }
+    g_mutex_unlock(&queue_lock);
+
+    graphics_hub_flush_pages(&engine.hub);
+
+    g_mutex_lock(&gl_lock);
+    for (int layer = 0; layer < CHROMA_LAYERS; layer++) {
+        StatusQueue *queue = &flush_queue[layer];
+
+        for (size_t i = 0; i < queue->count; i++) {
+            chroma_update_layer(queue->items[i]);
         }
 
+        queue->count = 0;
+    }
+    g_mutex_unlock(&gl_lock);
+}
+
+static void chroma_close_conn(Client *client) {
+    log_file(LogMessage, "Engine", "Closing client %d", client->client_sock);
+
+    shutdown(client->client_sock, SHUT_RDWR);
+    close(client->client_sock);
+    parser_free_client(client);
+}
+
+/*
+ * Run by the worker pool when a client socket is 
+ * readable. Client sockets are registered with 
+ * EPOLLONESHOT, so a client is handled by one 
+ * worker at a time, and is registered again once 
+ * the buffered messages have been parsed.
+ */
+static void chroma_handle_conn(gpointer data, gpointer user_data) {
+    Client *client = (Client *)data;
+    int open, res;
+
+    g_mutex_lock(&lock);
+    open = active;
+    g_mutex_unlock(&lock);
+
+    if (!open) {
+        log_file(LogMessage, "Engine", "Engine is not active, closing client %d handler", client->client_sock);
+        chroma_close_conn(client);
+        return;
+    }
+
+    open = (parser_tcp_recieve_client(client) == 0);
+
+    while ((res = parser_parse_graphic(&engine, client, &client->status)) > 0) {
+        PageStatus status = client->status;
         if (status.action == BLANK) {
             continue;
         }
@@ -62,33 +156,67 @@ static void *chroma_handle_conn(void *data) {
         log_file(LogMessage, "Engine", "Recieved Action: Temp ID %d, Layer %d, Action %d", 
                  status.temp_id, status.layer, status.action);
 
-        g_mutex_lock(&gl_lock);
-        IPage *page = graphics_hub_get_page(&engine.hub, status.temp_id);
-        if (status.action == ANIMATE_ON || status.temp_id != page_num[status.layer]) {
-            frame_num[status.layer] = 1;
-        } else if (status.action == CONTINUE && page != NULL) {
-            frame_num[status.layer] = MIN(frame_num[status.layer] + 1, page->max_keyframe - 1);
-        } else if (status.action == ANIMATE_OFF && page != NULL) {
-            frame_num[status.layer] = page->max_keyframe - 1;
-        }
+        chroma_queue_update(status);
+    }
 
-        page_num[status.layer]   = status.temp_id;
-        action[status.layer]     = status.action;
-        frame_time[status.layer] = 0.0;
+    if (res < 0 || !open) {
+        chroma_close_conn(client);
+        return;
+    }
 
-        g_mutex_unlock(&gl_lock);
+    struct epoll_event event = {.events = EPOLLIN | EPOLLONESHOT, .data.ptr = client};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->client_sock, &event) < 0) {
+        log_file(LogWarn, "Engine", "Error polling client %d", client->client_sock);
+        chroma_close_conn(client);
     }
+}
 
-    shutdown(client.client_sock, SHUT_RDWR);
-    return NULL;
+static void chroma_accept_conns(int server_sock) {
+    while (1) {
+        int client_sock = parser_accept_conn(server_sock);
+        if (client_sock < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log_file(LogMessage, "Engine", "Error connecting to new client");
+            }
+
+            return;
+        }
+
+        if (parser_tcp_set_nonblocking(client_sock) < 0) {
+            close(client_sock);
+            continue;
+        }
+
+        Client *client = parser_new_client(client_sock);
+        struct epoll_event event = {.events = EPOLLIN | EPOLLONESHOT, .data.ptr = client};
+
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_sock, &event) < 0) {
+            log_file(LogWarn, "Engine", "Error polling client %d", client_sock);
+            chroma_close_conn(client);
+        }
+    }
 }
 
+/*
+ * Accept clients and wait for client messages with 
+ * epoll on a single thread, readable clients are 
+ * passed to a pool of SERVER_WORKERS threads which 
+ * parse the messages, so the number of threads does 
+ * not depend on the number of clients.
+ *
+ * The parsed updates are applied every SERVER_FLUSH_US,
+ * once per frame, by chroma_flush_updates.
+ */
 static void *chroma_listen(void *data) {
     unsigned char exit = 0;
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    gint64 next_flush = g_get_monotonic_time() + SERVER_FLUSH_US;
     log_file(LogMessage, "Engine", "Starting main engine server");
 
     int server_sock = parser_tcp_start_server(engine.server_port);
-    if (server_sock < 0) {
+    epoll_fd = (server_sock < 0) ? -1 : epoll_create1(0);
+
+    if (server_sock < 0 || epoll_fd < 0 || parser_tcp_set_nonblocking(server_sock) < 0) {
         log_file(LogMessage, "Engine", "Error creating socket, closing server");
 
         g_mutex_lock(&lock);
@@ -97,6 +225,12 @@ static void *chroma_listen(void *data) {
         return NULL;
     }
 
+    // the server socket is registered with a NULL ptr
+    struct epoll_event server_event = {.events = EPOLLIN, .data.ptr = NULL};
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_sock, &server_event);
+
+    GThreadPool *workers = g_thread_pool_new(chroma_handle_conn, NULL, SERVER_WORKERS, TRUE, NULL);
+
     while (!exit) {
         g_mutex_lock(&lock);
         if (!active) {
@@ -108,16 +242,39 @@ static void *chroma_listen(void *data) {
 
         g_mutex_unlock(&lock);
 
-        int client_sock = parser_accept_conn(server_sock);
-        if (client_sock < 0) {
-            log_file(LogMessage, "Engine", "Error connecting to new client");
-            continue;
+        gint64 now = g_get_monotonic_time();
+        int timeout = (now < next_flush) ? (next_flush - now + 999) / 1000 : 0;
+
+        int num_events = epoll_wait(epoll_fd, events, SERVER_MAX_EVENTS, timeout);
+        if (num_events < 0 && errno != EINTR) {
+            log_file(LogWarn, "Engine", "Error waiting for clients");
         }
 
-        g_thread_new("client", chroma_handle_conn, &client_sock);
+        for (int i = 0; i < num_events; i++) {
+            if (events[i].data.ptr == NULL) {
+                chroma_accept_conns(server_sock);
+                continue;
+            }
+
+            g_thread_pool_push(workers, events[i].data.ptr, NULL);
+        }
+
+        now = g_get_monotonic_time();
+        if (now >= next_flush) {
+            chroma_flush_updates();
+            next_flush += SERVER_FLUSH_US;
+
+            if (next_flush <= now) {
+                next_flush = now + SERVER_FLUSH_US;
+            }
+        }
     }
 
+    g_thread_pool_free(workers, TRUE, TRUE);
+    close(epoll_fd);
+
     shutdown(server_sock, SHUT_RDWR);
+    close(server_sock);
     return NULL;
 }
 
@@ -129,6 +286,7 @@ int chroma_init_renderer(char *config_path, char *log_path) {
     }
 
     g_mutex_init(&engine.lock);
+    g_mutex_init(&engine.hub_lock);
     g_mutex_init(&gl_lock);
 
     sprintf(engine.hub_addr, "%s:%d", config.hub_addr, config.hub_port); 
@@ -159,6 +317,23 @@ int chroma_init_renderer(char *config_path, char *log_path) {
     return 0;
 }
 
+/*
+ * Render num_frames frames without a display, using
+ * an offscreen framebuffer instead of a GtkGLArea.
+ */
+int chroma_run_headless(int num_frames, char *dump_path) {
+    if (gl_headless_init(1920, 1080) < 0) {
+        log_file(LogWarn, "Engine", "Error initialising headless renderer");
+        return -1;
+    }
+
+    gl_headless_render(num_frames, dump_path);
+    gl_headless_free();
+
+    chroma_close_renderer(NULL, NULL);
+    return 0;
+}
+
 GtkWidget *chroma_new_renderer(void) {
     GtkWidget *gl_area;
     